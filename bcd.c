@@ -0,0 +1,94 @@
+#include "bcd.h"
+
+// 10的幂，bcdPow10[n] = 10^n，unsigned long 最多10位
+static unsigned long code bcdPow10[10] = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL,
+    100000000UL, 1000000000UL
+};
+
+// 清零
+void BCD_Clear(BYTE xdata *bcd) {
+    BYTE i;
+    for (i = 0; i < BCD_BYTES; i++) {
+        bcd[i] = 0;
+    }
+}
+
+// bcd += v
+// 先把 v 按10的幂逐位相减拆成压缩BCD加数，再逐字节带进位相加；
+// 每秒的增量通常只有几位，高位的减法循环直接跳过
+void BCD_Add(BYTE xdata *bcd, unsigned long v) {
+    BYTE add[BCD_BYTES];
+    BYTE i, n, d, lo, hi, carry;
+
+    while (v >= 100000000UL) {         // 超出8位的部分回绕丢弃
+        v -= 100000000UL;
+    }
+
+    for (i = 0; i < BCD_BYTES; i++) {
+        add[i] = 0;
+    }
+    for (n = BCD_DIGITS; n-- > 0; ) {
+        if (v < bcdPow10[n]) {
+            continue;
+        }
+        d = 0;
+        do {
+            v -= bcdPow10[n];
+            d++;
+        } while (v >= bcdPow10[n]);
+        add[n >> 1] |= (n & 1) ? (d << 4) : d;
+    }
+
+    carry = 0;
+    for (i = 0; i < BCD_BYTES; i++) {
+        if (add[i] == 0 && carry == 0) {
+            continue;
+        }
+        lo = (bcd[i] & 0x0F) + (add[i] & 0x0F) + carry;
+        hi = (bcd[i] >> 4) + (add[i] >> 4);
+        if (lo > 9) {
+            lo -= 10;
+            hi++;
+        }
+        carry = 0;
+        if (hi > 9) {
+            hi -= 10;
+            carry = 1;
+        }
+        bcd[i] = (hi << 4) | lo;
+    }
+}
+
+// bcd = v
+void BCD_FromULong(BYTE xdata *bcd, unsigned long v) {
+    BCD_Clear(bcd);
+    BCD_Add(bcd, v);
+}
+
+// 十进制字符串：从最高位起逐位减10的幂，每位最多减9次；
+// buf 至少 BCD_FORMAT_SIZE 字节，不输出前导零，返回位数
+BYTE BCD_Format(char *buf, unsigned long v) {
+    BYTE n, len;
+    char d;
+
+    n = 9;
+    while (n > 0 && v < bcdPow10[n]) {  // 跳过前导零
+        n--;
+    }
+    len = n + 1;
+    for (;;) {
+        d = '0';
+        while (v >= bcdPow10[n]) {
+            v -= bcdPow10[n];
+            d++;
+        }
+        *buf++ = d;
+        if (n == 0) {
+            break;
+        }
+        n--;
+    }
+    *buf = '\0';
+    return len;
+}
@@ -0,0 +1,27 @@
+#ifndef __BCD_H__
+#define __BCD_H__
+
+#include "reg51.h"
+#include "pca.h"
+
+/*
+ * 十进制转换：压缩BCD计数与整数格式化
+ * - 每字节两位十进制，bcd[0] 低4位为个位，共 BCD_BYTES*2 位
+ * - 只用减法和比较，不调用 32 位除法库函数(?C?ULDIV)
+ * - 用于数码管显示：计数值增量更新后，各位直接取半字节查段码表
+ * - BCD_Format 把 unsigned long 转为十进制字符串，供串口输出
+ */
+
+#define BCD_BYTES   4         // 8位十进制
+#define BCD_DIGITS  (BCD_BYTES * 2)
+#define BCD_FORMAT_SIZE 11    // BCD_Format 缓冲区大小：10位 + 结束符
+
+// 取第 n 位(0=个位)
+#define BCD_DIGIT(bcd, n)  (((n) & 1) ? ((bcd)[(n) >> 1] >> 4) : ((bcd)[(n) >> 1] & 0x0F))
+
+void BCD_Clear(BYTE xdata *bcd);                        // 清零
+void BCD_Add(BYTE xdata *bcd, unsigned long v);         // bcd += v，超出8位回绕
+void BCD_FromULong(BYTE xdata *bcd, unsigned long v);   // bcd = v 的低8位十进制
+BYTE BCD_Format(char *buf, unsigned long v);            // 转十进制字符串，返回位数
+
+#endif /* __BCD_H__ */
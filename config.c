@@ -0,0 +1,86 @@
+#include "config.h"
+#include "i2c.h"
+#include "keyboard_control.h"
+#include "power.h"
+
+// CRC-16/CCITT(多项式0x1021，初值0xFFFF)，逐位计算，配置块很短
+static WORD Config_Crc(BYTE *p, BYTE len) {
+    WORD crc = 0xFFFF;
+    BYTE i;
+
+    while(len--) {
+        crc ^= (WORD)(*p++) << 8;
+        for(i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static void Config_Defaults(void) {
+    timed_watering.enabled = 0;
+    timed_watering.start_hour = 6;      // 默认6点
+    timed_watering.start_min = 0;       // 0分
+    timed_watering.start_sec = 1;       // 1秒开始浇水
+    timed_watering.water_volume_ml = 100; // 浇水100毫升
+    manual_volume_cap = 0;
+    power_sleep_start = POWER_SLEEP_START;
+    power_sleep_end = POWER_SLEEP_END;
+    datetime_display_pref = DISPLAY_TIME_MODE;
+}
+
+bit Config_Load(void) {
+    BYTE buf[CONFIG_SIZE];
+    BYTE len;
+
+    EEPROM_ReadBuf(CONFIG_ADDR, buf, CONFIG_SIZE);  // 影子区，不访问总线
+    if(buf[1] == CONFIG_VERSION) {
+        len = CONFIG_SIZE - 2;
+    } else {
+        len = CONFIG_V1_DATA;       // 版本1，下次保存时升级
+    }
+    if(buf[0] != CONFIG_MAGIC || (buf[1] != CONFIG_VERSION && buf[1] != 1) ||
+       Config_Crc(buf, len) != (buf[len] | ((WORD)buf[len + 1] << 8))) {
+        Config_Defaults();
+        PCA_SetDisplayMode(datetime_display_pref);
+        return 1;
+    }
+    timed_watering.enabled = buf[2];
+    timed_watering.start_hour = buf[3];
+    timed_watering.start_min = buf[4];
+    timed_watering.start_sec = buf[5];
+    timed_watering.water_volume_ml = buf[6] | ((WORD)buf[7] << 8);
+    manual_volume_cap = buf[8] | ((WORD)buf[9] << 8);
+    power_sleep_start = buf[10];
+    power_sleep_end = buf[11];
+    if(len > CONFIG_V1_DATA && buf[12] == DISPLAY_DATE_MODE) {
+        datetime_display_pref = DISPLAY_DATE_MODE;
+    } else {
+        datetime_display_pref = DISPLAY_TIME_MODE;
+    }
+    PCA_SetDisplayMode(datetime_display_pref);
+    return 0;
+}
+
+void Config_Save(void) {
+    BYTE buf[CONFIG_SIZE];
+    WORD crc;
+
+    buf[0] = CONFIG_MAGIC;
+    buf[1] = CONFIG_VERSION;
+    buf[2] = timed_watering.enabled;
+    buf[3] = timed_watering.start_hour;
+    buf[4] = timed_watering.start_min;
+    buf[5] = timed_watering.start_sec;
+    buf[6] = (BYTE)timed_watering.water_volume_ml;
+    buf[7] = (BYTE)(timed_watering.water_volume_ml >> 8);
+    buf[8] = (BYTE)manual_volume_cap;
+    buf[9] = (BYTE)(manual_volume_cap >> 8);
+    buf[10] = power_sleep_start;
+    buf[11] = power_sleep_end;
+    buf[12] = datetime_display_pref;
+    crc = Config_Crc(buf, CONFIG_SIZE - 2);
+    buf[13] = (BYTE)crc;
+    buf[14] = (BYTE)(crc >> 8);
+    EEPROM_WriteBuf(CONFIG_ADDR, buf, CONFIG_SIZE);  // 内容不变时不产生写入
+}
@@ -0,0 +1,36 @@
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+#include "reg51.h"
+#include "pca.h"
+
+/*
+ * 配置块：浇水日程、手动水量上限、睡眠时段、开机显示模式集中存放在24C02设置区
+ * - 上电时设置区随 I2C_Init 一次连续读入影子区，Config_Load 只从内存解析
+ * - 标识、版本号不符或CRC错误时使用默认值；版本1(无显示模式)照常读入
+ * - 修改后调用 Config_Save：只更新影子区，内容有变化的页按写回策略写入器件
+ *
+ * 格式(低字节在前)：
+ *   0 标识 1 版本 2 启用 3~5 时分秒 6~7 浇水毫升数 8~9 手动上限
+ *   10~11 睡眠时段 12 显示模式(DISPTIME/DISPDATE) 13~14 CRC-16(前13字节)
+ *   版本1没有显示模式字节，CRC在12~13
+ */
+
+#define CONFIG_ADDR      0x20    // 配置块地址(设置区内，页对齐)
+#define CONFIG_MAGIC     0x55    // 标识，与旧版初始化标志值相同
+#define CONFIG_VERSION   2       // 格式变化时加1
+#define CONFIG_SIZE      15
+#define CONFIG_V1_DATA   12      // 版本1的数据字节数
+
+bit Config_Load(void);           // 从影子区恢复配置，无效时用默认值并返回1
+void Config_Save(void);          // 保存当前配置(只写影子区)
+
+// 旧接口：日程、闹钟时间与初始化标志都在配置块中
+#define SaveWateringToEEPROM()    Config_Save()
+#define ReadWateringFromEEPROM()  Config_Load()
+#define SaveAlarmToEEPROM()       Config_Save()
+#define ReadAlarmFromEEPROM()     Config_Load()
+#define SetInitializedFlag()      Config_Save()
+#define IsFirstPowerOn()          (EEPROM_Read(CONFIG_ADDR) != CONFIG_MAGIC)
+
+#endif /* __CONFIG_H__ */
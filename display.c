@@ -0,0 +1,48 @@
+#include "display.h"
+#include "flowmeter.h"
+#include "keyboard_control.h"
+
+BYTE disp_views = 0;
+BYTE disp_dirty = 0;
+static BYTE dispTop = 0;        // 上次画出的视图
+
+void Display_Init(void) {
+    disp_views = DISP_VIEW_CLOCK;
+    disp_dirty = DISP_VIEW_EDIT | DISP_VIEW_FLOW | DISP_VIEW_PARAM | DISP_VIEW_CLOCK;
+    dispTop = 0;
+}
+
+// 取最低的置位，即优先级最高的请求视图
+BYTE Display_Top(void) {
+    BYTE v = disp_views | DISP_VIEW_CLOCK;
+    return v & (BYTE)(0 - v);
+}
+
+// 各视图的绘制函数只在这里调用，每轮主循环最多画一个视图
+void Display_Render(void) {
+    BYTE top = Display_Top();
+
+    if (top != dispTop) {       // 换了视图，整屏重画
+        dispTop = top;
+        disp_dirty |= top;
+    }
+    if (!(disp_dirty & top)) {
+        return;
+    }
+    disp_dirty &= ~top;
+
+    switch (top) {
+        case DISP_VIEW_EDIT:
+            PCA_RenderEdit();
+            break;
+        case DISP_VIEW_FLOW:
+            FlowMeter_UpdateDisplay();
+            break;
+        case DISP_VIEW_PARAM:
+            DisplayAutoWateringParams();
+            break;
+        default:
+            PCA_RenderClock();
+            break;
+    }
+}
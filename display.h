@@ -0,0 +1,34 @@
+#ifndef __DISPLAY_H__
+#define __DISPLAY_H__
+
+#include "reg51.h"
+#include "pca.h"
+
+/*
+ * 显示合成：各模块不再直接改写 dispbuff
+ * - 每个视图有一个"请求显示"位和一个"需重画"位
+ * - 模块只在状态变化时 DISPLAY_SHOW/HIDE，内容变化时 DISPLAY_INVALIDATE
+ * - 主循环每轮调用一次 Display_Render：只画优先级最高的视图，且只在它变脏
+ *   或刚切换到它时画一次，随后 PCA_DisplayCommit 提交
+ * - 时钟视图总是可显示，作为最低优先级的兜底
+ * - 只在主循环中使用，中断不访问
+ */
+
+// 视图(位号越小优先级越高)
+#define DISP_VIEW_EDIT   0x01   // 日期时间设置(闪烁)      pca.c
+#define DISP_VIEW_FLOW   0x02   // 浇水中：当前/累计流量    flowmeter.c
+#define DISP_VIEW_PARAM  0x04   // 定时浇水参数/剩余水量    keyboard_control.c
+#define DISP_VIEW_CLOCK  0x08   // 时间/日期轮换            pca.c
+
+extern BYTE disp_views;         // 请求显示的视图
+extern BYTE disp_dirty;         // 内容已变、需要重画的视图
+
+#define DISPLAY_SHOW(v)        (disp_views |= (v))
+#define DISPLAY_HIDE(v)        (disp_views &= ~(v))
+#define DISPLAY_INVALIDATE(v)  (disp_dirty |= (v))
+
+void Display_Init(void);        // 只显示时钟，全部视图标记为脏
+BYTE Display_Top(void);         // 当前优先级最高的视图
+void Display_Render(void);      // 重画当前视图(主循环每轮调用一次)
+
+#endif /* __DISPLAY_H__ */
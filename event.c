@@ -0,0 +1,25 @@
+#include "event.h"
+
+BYTE idata evt_buf[EVT_QUEUE_SIZE];
+BYTE evt_head = 0;
+BYTE evt_tail = 0;
+BYTE evt_overflow = 0;
+
+// 清空队列
+void Event_Init(void) {
+    evt_head = 0;
+    evt_tail = 0;
+    evt_overflow = 0;
+}
+
+// 取出一个事件，队列空返回 EVT_NONE
+BYTE Event_Get(void) {
+    BYTE e;
+    
+    if(evt_tail == evt_head) {
+        return EVT_NONE;
+    }
+    e = evt_buf[evt_tail];
+    evt_tail = (evt_tail + 1) & (EVT_QUEUE_SIZE - 1);  // 先取数据，再释放位置
+    return e;
+}
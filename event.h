@@ -0,0 +1,44 @@
+#ifndef __EVENT_H__
+#define __EVENT_H__
+
+#include "reg51.h"
+#include "pca.h"
+
+/*
+ * 中断 -> 主循环 事件队列
+ * - 生产者：PCA_isr(含 Key_Tick)、INT0_ISR、UART_ISR(同一优先级，互不嵌套，等效单生产者)
+ * - 消费者：主循环 Event_Get
+ * - 生产者只写 evt_head，消费者只写 evt_tail，均为单字节，无需关中断
+ * - 队列满时丢弃新事件并计入 evt_overflow
+ */
+
+// 事件类型
+#define EVT_NONE         0    // 队列为空
+#define EVT_SECOND       1    // 秒节拍(秒数本身由 pending_seconds 计数，不会丢失)
+#define EVT_HALF_SECOND  2    // 半秒节拍(编辑模式闪烁)
+#define EVT_UART_LINE    3    // 串口收到一行完整命令
+#define EVT_VOLUME_DONE  4    // 达到目标脉冲数，INT0中断已关阀
+#define EVT_KEY          0x80 // 按键事件，低7位为类型和键号(见 key.h)
+
+#define EVT_QUEUE_SIZE   16   // 队列大小(必须为2的幂)
+
+extern BYTE idata evt_buf[EVT_QUEUE_SIZE];
+extern BYTE evt_head;
+extern BYTE evt_tail;
+extern BYTE evt_overflow;     // 丢弃的事件数(饱和于255)
+
+// 在中断中投递事件：写成宏，避免多个中断调用同一函数
+#define EVENT_POST(e) do {                                      \
+        BYTE evt_next = (evt_head + 1) & (EVT_QUEUE_SIZE - 1);  \
+        if(evt_next != evt_tail) {                              \
+            evt_buf[evt_head] = (e);                            \
+            evt_head = evt_next;                                \
+        } else if(evt_overflow != 0xFF) {                       \
+            evt_overflow++;                                     \
+        }                                                       \
+    } while(0)
+
+void Event_Init(void);        // 清空队列
+BYTE Event_Get(void);         // 取出一个事件，队列空返回 EVT_NONE
+
+#endif /* __EVENT_H__ */
@@ -2,6 +2,11 @@
 #include "intrins.h"
 #include "i2c.h"  
 #include "uart.h"
+#include "relay.h"
+#include "event.h"
+#include "bcd.h"
+#include "display.h"
+#include "power.h"
 
 /*
  * ========================================
@@ -31,25 +36,126 @@
  * └─────────────────────────────────────────────────┘
  */
 
+#if FLOW_BACKEND == FLOW_BACKEND_T2
+// 定时器2寄存器(reg51.h未定义)
+sfr T2CON  = 0xC8;
+sfr RCAP2L = 0xCA;
+sfr RCAP2H = 0xCB;
+sfr TL2    = 0xCC;
+sfr TH2    = 0xCD;
+sbit TF2   = T2CON^7;                     // 溢出标志
+sbit TR2   = T2CON^2;                     // 运行控制
+sbit ET2   = IE^5;                        // 定时器2中断允许
+
+typedef unsigned long PULSES;             // 硬件16位计数 + 软件溢出扩展为32位
+#else
+typedef WORD PULSES;
+#endif
+
 // 流量计参数
 static BYTE flowMode = FLOW_MODE_OFF;     // 流量显示模式
-static WORD pulseCount = 0;               // 当前流量脉冲计数
-static unsigned long currentFlow = 0;              // 当前流量值（毫升/秒）
+#if FLOW_BACKEND == FLOW_BACKEND_T2
+static WORD t2High = 0;                   // T2溢出次数(计数高16位)，仅由T2中断自增
+static unsigned long t2Bias = 0;          // 预置T2造成的计数跳变补偿
+static bit targetArmed = 0;               // 下一次T2溢出即到达目标水量
+#else
+static WORD pulseTotal = 0;               // 脉冲计数，仅由INT0中断自增(自由运行，溢出回绕)
+static WORD pulseTarget = 0;              // 距目标剩余脉冲数，INT0中断倒计数(0=未设置)
+#endif
+static PULSES pulseSnapshot = 0;          // 上次统计时的脉冲计数
+static unsigned long currentFlow = 0;              // 当前流量显示值（0.1毫升/秒）
+
+// 脉冲周期测速：INT0中断记录最近一个脉冲的时间戳，主循环按周期求流速
+// (T2计数方式下没有逐脉冲时间戳，以主循环读到计数变化的时刻代替)
+#if FLOW_BACKEND != FLOW_BACKEND_T2
+static BYTE edgeTick;                     // 最近脉冲时的pca_tick
+static WORD edgeOffset;                   // 最近脉冲距该节拍的PCA计数
+#endif
+static PULSES rateCount;                  // 测速起点的脉冲计数
+static BYTE rateTick;                     // 测速起点时间戳
+static WORD rateOffset;
+static bit rateValid = 0;                 // 测速起点有效
+static unsigned long xdata flowRate = 0;  // 平滑后的流速(毫升/秒，Q8定点)
 
 static bit isRunning = 0;                 // 流量计运行状态
-static bit needUpdateDisplay = 0;         // 显示更新标志
 static BYTE initialDisplayDelay = 0;      // 初始显示延迟计数器
 
 // 24C02存储控制变量
-static BYTE saveCounter = 0;              // 定期保存计数器
+static WORD saveCounter = 0;              // 定期保存计数器
 static bit totalFlowChanged = 0;          // 累计流量变化标志
 static unsigned long xdata lastSavedFlow = 0;   // 上次保存的累计流量
+static BYTE xdata totalBcd[BCD_BYTES];          // totalFlow 的十进制镜像，随增量同步更新
+static BYTE xdata flowBcd[BCD_BYTES];           // 当前流量显示用
+static BYTE xdata shownBcd[BCD_BYTES];          // 数码管上正在显示的流量值
+static BYTE xdata shownMark;                    // 正在显示的模式标识(10/11)
 
 // 流量计参数定义
 #define PULSE_FACTOR 1                   // 每个脉冲代表1毫升
 #define FLOW_UPDATE_INTERVAL 1           // 每秒更新一次流量值
+#if POWER_FAIL == POWER_FAIL_NONE
 #define SAVE_INTERVAL 10                 // 每10秒保存一次到24C02
 #define IMMEDIATE_SAVE_THRESHOLD 50      // 累计差值超过50ml立即保存
+#else
+#define SAVE_INTERVAL 900                // 掉电时另有最后一次保存，定期保存只作后备(15分钟)
+#endif
+#define FLOW_RATE_Q 8                    // 流速定点小数位数(1/256 毫升/秒)
+#define FLOW_RATE_SMOOTH 2               // 指数平滑系数 1/4
+#define FLOW_RATE_TIMEOUT 200            // 2秒无脉冲视为停流(10ms节拍)
+
+#if FLOW_BACKEND == FLOW_BACKEND_T2
+// 读取脉冲计数：TH2/TL2与溢出次数需一致
+// 屏蔽T2中断读取；若读取期间已溢出(TF2置位)，先让中断处理溢出再重读
+static PULSES ReadPulseTotal(void) {
+    BYTE th, tl;
+    WORD high;
+    
+    for (;;) {
+        ET2 = 0;
+        th = TH2;
+        tl = TL2;
+        if (TH2 != th) {               // 低字节进位，重读
+            th = TH2;
+            tl = TL2;
+        }
+        high = t2High;
+        if (!TF2) {
+            break;
+        }
+        ET2 = 1;
+        _nop_();                       // 写IE后至少再执行一条指令才响应中断
+    }
+    ET2 = 1;
+    return ((((unsigned long)high << 8 | th) << 8) | tl) + t2Bias;
+}
+#else
+// 读取脉冲计数：两字节分开读取，短暂屏蔽INT0防止读到一半被改写
+// 屏蔽期间到达的下降沿由IE0锁存，开中断后立即补计，不会丢失
+static PULSES ReadPulseTotal(void) {
+    WORD pulses;
+    EX0 = 0;
+    pulses = pulseTotal;
+    EX0 = 1;
+    return pulses;
+}
+#endif
+
+// 取出上次统计以来的脉冲数
+static PULSES TakePulses(void) {
+    PULSES pulses, delta;
+    pulses = ReadPulseTotal();
+    delta = pulses - pulseSnapshot;
+    pulseSnapshot = pulses;
+    return delta;
+}
+
+// 累加到累计流量
+static void AddTotalFlow(PULSES pulses) {
+    if (pulses > 0) {
+        totalFlow += (unsigned long)pulses * PULSE_FACTOR;
+        BCD_Add(totalBcd, (unsigned long)pulses * PULSE_FACTOR);
+        totalFlowChanged = 1;
+    }
+}
 
 // 流量计初始化
 void FlowMeter_Init(void) {
@@ -61,50 +167,34 @@ void FlowMeter_Init(void) {
      * - P2.0/P2.1: I2C接口，连接24C02存储芯片
      */
 
-    char flowStr[12];
-    char temp[12];
-    BYTE i = 0, j = 0;
-    unsigned long tempFlow;
+    char flowStr[BCD_FORMAT_SIZE];
 
+#if FLOW_BACKEND == FLOW_BACKEND_T2
+    T2CON = 0x02;                      // C/T2=1 外部计数，16位自动重装，T2EX不用
+    RCAP2L = 0;                        // 溢出后从0继续计数
+    RCAP2H = 0;
+    TL2 = 0;
+    TH2 = 0;
+    ET2 = 1;                           // 溢出中断：扩展计数、目标水量
+    TR2 = 1;
+#else
     IT0 = 1;                           // 设置INT0为边沿触发（下降沿触发）
     EX0 = 1;                           // 使能INT0中断
-    pulseCount = 0;                    // 初始化脉冲计数
+#endif
+    pulseSnapshot = ReadPulseTotal();  // 初始化脉冲计数起点
     currentFlow = 0;                   // 初始化当前流量
     
     // 从24C02读取累计流量数据
     totalFlow = AT24C02_ReadTotalFlow();
+    BCD_FromULong(totalBcd, totalFlow);
 
     lastSavedFlow = totalFlow;         // 立即保存原始值
     
     // 发送累计流量到串口进行调试
     UART_SendString("Total Flow: ");
     
-    if(totalFlow == 0) {
-        UART_SendString("0");
-    } else {
-        tempFlow = totalFlow;
-        i = 0;  // 重置索引
-        
-        // 从低位到高位提取数字
-        while(tempFlow > 0 && i < 10) {  // 添加边界检查
-            temp[i++] = '0' + (tempFlow % 10);
-            tempFlow /= 10;
-        }
-        
-        // 确保至少有一个数字
-        if(i == 0) {
-            temp[i++] = '0';
-        }
-        
-        // 反转字符串
-        j = 0;
-        while(i > 0 && j < 10) {  // 添加边界检查
-            flowStr[j++] = temp[--i];
-        }
-        flowStr[j] = '\0';
-        
-        UART_SendString(flowStr);
-    }
+    BCD_Format(flowStr, totalFlow);
+    UART_SendString(flowStr);
     
     UART_SendString(" ml\r\n");
     
@@ -117,40 +207,92 @@ void FlowMeter_Init(void) {
 // 启动流量计
 void FlowMeter_Start(void) {
     if (!isRunning) {
-        pulseCount = 0;                // 重置脉冲计数
+        pulseSnapshot = ReadPulseTotal(); // 之前的脉冲不计入本次
+#if FLOW_BACKEND != FLOW_BACKEND_T2
         EX0 = 1;                       // 使能INT0中断
+#endif
         isRunning = 1;                 // 标记流量计开始运行
         
         // 设置初始非零流量值
         currentFlow = 0; 
+        flowRate = 0;
+        rateValid = 0;
         
         // 强制立即更新显示
-        needUpdateDisplay = 1;
+        DISPLAY_INVALIDATE(DISP_VIEW_FLOW);
         initialDisplayDelay = 2;       // 设置初始显示延迟
     }
 }
 
 // 停止流量计
 void FlowMeter_Stop(void) {
+    FlowMeter_SetTarget(0);
+    
+    // 不足一秒的脉冲立即计入，浇水记录和保存的累计流量才准确
+    if (isRunning) {
+        AddTotalFlow(TakePulses());
+    }
     isRunning = 0;                     // 标记流量计停止
+    flowRate = 0;
+    rateValid = 0;
     // 不关闭中断，以便继续统计总流量
 }
 
 // 复位流量计累计值
 void FlowMeter_Reset(void) {
-    pulseCount = 0;                    // 重置脉冲计数
+    pulseSnapshot = ReadPulseTotal();  // 重置脉冲计数起点
     currentFlow = 0;                   // 重置当前流量
 
 }
 
+// 设置目标水量：脉冲到达时由INT0中断直接关阀并投递EVT_VOLUME_DONE
+// 目标从当前时刻算起，应在 FlowMeter_Start 之后、开阀之前设置
+#if FLOW_BACKEND == FLOW_BACKEND_T2
+// T2方式：把计数器预置为 65536-目标脉冲数，到达目标时正好溢出进中断关阀；
+// 计数跳变记入t2Bias，累计值不受影响。预置时T2停走几个机器周期
+void FlowMeter_SetTarget(WORD ml) {
+    WORD pulses = (ml + PULSE_FACTOR - 1) / PULSE_FACTOR;
+    WORD now, preset;
+    
+    ET2 = 0;
+    targetArmed = 0;
+    if (pulses) {
+        TR2 = 0;
+        if (TF2) {                     // 停走前刚好溢出，先计入
+            TF2 = 0;
+            t2High++;
+        }
+        now = ((WORD)TH2 << 8) | TL2;
+        preset = 0 - pulses;
+        TL2 = (BYTE)preset;
+        TH2 = preset >> 8;
+        TR2 = 1;
+        t2Bias += (WORD)(now - preset);
+        if (now < preset) {            // 预置值更大，高位借位
+            t2Bias -= 0x10000UL;
+        }
+        targetArmed = 1;
+    }
+    ET2 = 1;
+}
+#else
+void FlowMeter_SetTarget(WORD ml) {
+    WORD pulses = (ml + PULSE_FACTOR - 1) / PULSE_FACTOR;
+    EX0 = 0;                           // 双字节写入期间屏蔽INT0
+    pulseTarget = pulses;
+    EX0 = 1;
+}
+#endif
+
 // 计算流量（每秒调用一次，由中断触发）
 void FlowMeter_CalcFlow(void) {
     static BYTE updateCounter = 0;
+    PULSES delta;
     
     if (initialDisplayDelay > 0) {
         initialDisplayDelay--;
         if (initialDisplayDelay == 0) {
-            needUpdateDisplay = 1;
+            DISPLAY_INVALIDATE(DISP_VIEW_FLOW);
         }
     }
     
@@ -158,24 +300,19 @@ void FlowMeter_CalcFlow(void) {
     if (++updateCounter >= FLOW_UPDATE_INTERVAL) {
         updateCounter = 0;
         
+        // 取快照求差：计数只增不减，主循环每次只读一次，统计间隙的脉冲留到下次
+        delta = TakePulses();
+        
         if (isRunning) {
-            currentFlow = pulseCount;
-            
             // 更新累计流量（毫升）
-            if (currentFlow > 0) {
-                unsigned long oldTotalFlow = totalFlow;
-                totalFlow += currentFlow;
-                
-                // 标记累计流量已改变
-                if (totalFlow != oldTotalFlow) {
-                    totalFlowChanged = 1;
-                }
-                
-                // 检查是否需要立即保存（防止大量数据丢失）
-                if (totalFlow - lastSavedFlow >= IMMEDIATE_SAVE_THRESHOLD) {
-                    SaveTotalFlowToEEPROM();
-                }
+            AddTotalFlow(delta);
+            
+#ifdef IMMEDIATE_SAVE_THRESHOLD
+            // 检查是否需要立即保存（防止大量数据丢失）
+            if (totalFlow - lastSavedFlow >= IMMEDIATE_SAVE_THRESHOLD) {
+                SaveTotalFlowToEEPROM();
             }
+#endif
         }
         
         // 定期保存累计流量到24C02
@@ -188,9 +325,7 @@ void FlowMeter_CalcFlow(void) {
             }
         }
         
-        // 重置脉冲计数，准备下次统计
-        pulseCount = 0;
-        needUpdateDisplay = 1;
+        DISPLAY_INVALIDATE(DISP_VIEW_FLOW);
     }
     
     // 轮流显示切换逻辑
@@ -200,7 +335,7 @@ void FlowMeter_CalcFlow(void) {
         if (++displayToggle >= 3) {  
             displayToggle = 0;
             flowMode = (flowMode == FLOW_MODE_CURR) ? FLOW_MODE_TOTAL : FLOW_MODE_CURR;
-            needUpdateDisplay = 1;
+            DISPLAY_INVALIDATE(DISP_VIEW_FLOW);
         }
     }
 }
@@ -217,65 +352,185 @@ void SaveTotalFlowToEEPROM(void) {
 
 }
 
-void FlowMeter_UpdateDisplay(void) {
-    if (needUpdateDisplay) {
-        needUpdateDisplay = 0;  // 清除标志
-        
-        // 根据当前模式更新显示
+// 强制保存：先并入本秒尚未统计的脉冲，不等定期保存的间隔(掉电时调用)
+void FlowMeter_ForceSave(void) {
+    if (isRunning) {
+        AddTotalFlow(TakePulses());
+    }
+    SaveTotalFlowToEEPROM();
+}
+
+// 有未保存的流量，包括本秒尚未统计的脉冲
+bit FlowMeter_HasUnsavedChanges(void) {
+    return totalFlowChanged || (isRunning && ReadPulseTotal() != pulseSnapshot);
+}
+
+// 按脉冲周期更新流速(主循环每次调用)
+// 流速 = 脉冲数 / 两个脉冲时间戳之差，每来一个脉冲更新一次，再做指数平滑
+void FlowMeter_UpdateRate(void) {
+    PULSES count, edges;
+    WORD offset;
+    BYTE tick, gap;
+    unsigned long cycles, num, sample, bound;
+#if FLOW_BACKEND == FLOW_BACKEND_T2
+    BYTE hi, lo;
+#endif
+    
+    if (!isRunning) {
+        return;
+    }
+    
+#if FLOW_BACKEND == FLOW_BACKEND_T2
+    count = ReadPulseTotal();
+    EA = 0;                            // 节拍号、比较值与计数器需一致
+    hi = CH;
+    lo = CL;
+    if (CH != hi) {
+        hi = CH;
+        lo = CL;
+    }
+    tick = pca_tick;
+    offset = (((WORD)hi << 8) | lo) - PCA_LAST_TICK();
+    EA = 1;
+#else
+    EX0 = 0;                           // 时间戳和计数需一致
+    count = pulseTotal;
+    tick = edgeTick;
+    offset = edgeOffset;
+    EX0 = 1;
+#endif
+    
+    if (count != rateCount) {
+        if (rateValid) {
+            edges = count - rateCount;
+            // 偏移可能超过一个节拍(节拍中断尚未响应)，按有符号差计算
+            cycles = (unsigned long)(BYTE)(tick - rateTick) * T100Hz + (int)(offset - rateOffset);
+            
+            // 周期除以4避免乘法溢出，分辨率仍为4个机器周期
+            num = (unsigned long)edges * PULSE_FACTOR * (FOSC / 12 / 4);
+            cycles >>= 2;
+            if (cycles == 0) {
+                cycles = 1;
+            }
+            sample = ((num / cycles) << FLOW_RATE_Q) | (((num % cycles) << FLOW_RATE_Q) / cycles);
+            
+            if (flowRate == 0) {
+                flowRate = sample;
+            } else if (sample > flowRate) {
+                flowRate += (sample - flowRate) >> FLOW_RATE_SMOOTH;
+            } else {
+                flowRate -= (flowRate - sample) >> FLOW_RATE_SMOOTH;
+            }
+        }
+        rateCount = count;
+        rateTick = tick;
+        rateOffset = offset;
+        rateValid = 1;
+    } else if (rateValid) {
+        // 脉冲迟迟不来：流速不可能高于“1个脉冲/已等待时间”
+        // 节拍差为gap时实际已等待超过(gap-1)个节拍
+        gap = (BYTE)(pca_tick - rateTick);
+        if (gap >= FLOW_RATE_TIMEOUT) {
+            rateValid = 0;
+            flowRate = 0;
+        } else if (gap > 2) {
+            bound = ((unsigned long)PULSE_FACTOR * 100 << FLOW_RATE_Q) / (gap - 1);
+            if (flowRate > bound) {
+                flowRate = bound;
+            }
+        }
+    }
+    
+    // 显示值(0.1毫升/秒)变化时刷新
+    num = (flowRate * 10 + (1 << (FLOW_RATE_Q - 1))) >> FLOW_RATE_Q;
+    if (num != currentFlow) {
+        currentFlow = num;
         if (flowMode == FLOW_MODE_CURR) {
-            UpdateCurrentFlowDisplay();
-        } else if (flowMode == FLOW_MODE_TOTAL) {
-            UpdateTotalFlowDisplay();
+            DISPLAY_INVALIDATE(DISP_VIEW_FLOW);
         }
     }
 }
 
-void UpdateCurrentFlowDisplay(void) {
-    BYTE val1, val2, val3, val4, val5, val6, val7, val8;
+// 流量视图(由 Display_Render 在视图变脏时调用)
+void FlowMeter_UpdateDisplay(void) {
+    // 根据当前模式更新显示
+    if (flowMode == FLOW_MODE_CURR) {
+        UpdateCurrentFlowDisplay();
+    } else if (flowMode == FLOW_MODE_TOTAL) {
+        UpdateTotalFlowDisplay();
+    }
+}
+
+// 流量显示：第0位为模式标识，第1~7位为 bcd 的低7位十进制
+// 屏上已是同一模式的流量时只改写变化的数字位，否则整屏重画
+static void ShowFlowBcd(BYTE mark, BYTE xdata *bcd) {
+    BYTE i, diff;
     
-    // 提取当前流量各位数字（毫升/秒）- 支持最大9999999毫升/秒
-    unsigned long flow_display = (unsigned long)currentFlow;
+    if (disp_layout != DISP_LAYOUT_FLOW || shownMark != mark) {
+        FillCustomDispBuf8(mark, BCD_DIGIT(bcd, 0), BCD_DIGIT(bcd, 1), BCD_DIGIT(bcd, 2),
+                           BCD_DIGIT(bcd, 3), BCD_DIGIT(bcd, 4), BCD_DIGIT(bcd, 5),
+                           BCD_DIGIT(bcd, 6));
+        for (i = 0; i < BCD_BYTES; i++) {
+            shownBcd[i] = bcd[i];
+        }
+        shownMark = mark;
+        disp_layout = DISP_LAYOUT_FLOW;
+        if (mark == 10) {
+            dispbuff[2] |= 0x80;  // 个位小数点
+        }
+        return;
+    }
     
-    // 构造8位显示数字 - 格式：XXXXXXX10（前7位流量值，最后1位模式标识10）
-    val1 = 10;  // 模式标识保持不变 - "10"表示当前流量
-    val2 = (BYTE)(flow_display % 10);                    // 个位（毫升/秒）
-    val3 = (BYTE)((flow_display / 10) % 10);             // 十位（毫升/秒）
-    val4 = (BYTE)((flow_display / 100) % 10);            // 百位（毫升/秒）
-    val5 = (BYTE)((flow_display / 1000) % 10);           // 千位（毫升/秒）
-    val6 = (BYTE)((flow_display / 10000) % 10);          // 万位（毫升/秒）
-    val7 = (BYTE)((flow_display / 100000) % 10);         // 十万位（毫升/秒）
-    val8 = (BYTE)((flow_display / 1000000) % 10);        // 百万位（毫升/秒）
+    // 逐字节比较，相同的两位直接跳过；第7位(最高半字节)不显示
+    for (i = 0; i < BCD_BYTES; i++) {
+        diff = bcd[i] ^ shownBcd[i];
+        if (i == BCD_BYTES - 1) {
+            diff &= 0x0F;
+        }
+        if (diff == 0) {
+            continue;
+        }
+        if (diff & 0x0F) {
+            FillDispDigit(2 * i + 1, bcd[i] & 0x0F);
+        }
+        if (diff & 0xF0) {
+            FillDispDigit(2 * i + 2, bcd[i] >> 4);
+        }
+        shownBcd[i] = bcd[i];
+    }
+    if (mark == 10) {
+        dispbuff[2] |= 0x80;  // 个位小数点(该位重写后补上)
+    }
+}
+
+void UpdateCurrentFlowDisplay(void) {
+    // 当前流量（0.1毫升/秒）按10的幂相减转为BCD，不做除法 - 支持最大999999.9毫升/秒
+    BCD_FromULong(flowBcd, currentFlow);
     
-    // 使用8位显示缓冲区
-    FillCustomDispBuf8(val1, val2, val3, val4, val5, val6, val7, val8);
+    // 8位显示格式：XXXXXX.X10（前7位流量值含1位小数，最后1位模式标识10）
+    // "10"表示当前流量；其后依次为0.1毫升/秒、个位……十万位
+    ShowFlowBcd(10, flowBcd);
 }
 
 // 更新累计流量显示 - 扩展到8位数码管，支持7位流量值
 void UpdateTotalFlowDisplay(void) {
-    BYTE val1, val2, val3, val4, val5, val6, val7, val8;
-    
-    // 提取总流量各位数字（毫升）- 支持最大9999999毫升累计
-    unsigned long flow_ml = totalFlow;
-    
-    // 构造8位显示数字 - 格式：XXXXXXX11（前7位流量值，最后1位模式标识11）
-    val1 = 11;  // "11"表示累计流量
-    val2 = (BYTE)(flow_ml % 10);                 // 个位（毫升）
-    val3 = (BYTE)((flow_ml / 10) % 10);          // 十位（毫升）
-    val4 = (BYTE)((flow_ml / 100) % 10);         // 百位（毫升）
-    val5 = (BYTE)((flow_ml / 1000) % 10);        // 千位（毫升）
-    val6 = (BYTE)((flow_ml / 10000) % 10);       // 万位（毫升）
-    val7 = (BYTE)((flow_ml / 100000) % 10);      // 十万位（毫升）
-    val8 = (BYTE)((flow_ml / 1000000) % 10);     // 百万位（毫升）
-    
-    // 使用8位显示缓冲区
-    FillCustomDispBuf8(val1, val2, val3, val4, val5, val6, val7, val8);
+    // 总流量各位直接取自BCD镜像（毫升），不做除法 - 支持最大9999999毫升累计
+    // 8位显示格式：XXXXXXX11（前7位流量值，最后1位模式标识11）
+    // "11"表示累计流量；其后依次为个位……百万位
+    ShowFlowBcd(11, totalBcd);
 }
 
 // 设置流量显示模式
 void FlowMeter_SetMode(BYTE mode) {
     flowMode = mode;
 
-    needUpdateDisplay = 1;
+    // 浇水期间流量视图遮住参数和时钟，关闭后自动回到下一级视图
+    if (mode == FLOW_MODE_OFF) {
+        DISPLAY_HIDE(DISP_VIEW_FLOW);
+    } else {
+        DISPLAY_SHOW(DISP_VIEW_FLOW);
+    }
+    DISPLAY_INVALIDATE(DISP_VIEW_FLOW);
 }
 
 // 获取当前流量显示模式
@@ -288,7 +543,40 @@ unsigned long FlowMeter_GetTotalFlow(void) {
     return totalFlow;
 }
 
+#if FLOW_BACKEND == FLOW_BACKEND_T2
+// 定时器2中断：计数溢出，扩展高16位；预置了目标水量时这次溢出就是目标到达
+void T2_ISR() interrupt 5 {
+    TF2 = 0;
+    t2High++;
+    if (targetArmed) {
+        targetArmed = 0;
+        RELAY_OFF_ISR();
+        EVENT_POST(EVT_VOLUME_DONE);
+    }
+}
+#else
 // 外部中断0服务函数 - 用于脉冲计数
 void INT0_ISR() interrupt 0 {
-    pulseCount++;  // 每次中断增加脉冲计数
+    BYTE hi, lo;
+    
+    pulseTotal++;  // 每次中断增加脉冲计数
+    
+    // 时间戳：先读高字节，低字节进位导致高字节变化时重读
+    hi = CH;
+    lo = CL;
+    if (CH != hi) {
+        hi = CH;
+        lo = CL;
+    }
+    edgeTick = pca_tick;
+    edgeOffset = (((WORD)hi << 8) | lo) - PCA_LAST_TICK();
+    
+    // 目标水量倒计数：到达的这一个脉冲上立即关阀，不等每秒的检查
+    if (pulseTarget) {
+        if (--pulseTarget == 0) {
+            RELAY_OFF_ISR();
+            EVENT_POST(EVT_VOLUME_DONE);
+        }
+    }
 }
+#endif
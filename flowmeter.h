@@ -13,6 +13,17 @@
 #define flow_mode_indicator 5   // 使用数字5表示当前流量模式
 #define FLOW_SPEED_MULTIPLIER 1 // 流量倍增因子设为1，每个脉冲=1毫升
 
+// 脉冲计数方式(编译时选择)
+// FLOW_BACKEND_INT0: 脉冲经继电器接P3.2，每个脉冲进一次INT0中断(默认)
+// FLOW_BACKEND_T2  : 传感器接P1.0(T2)，定时器2计数器模式硬件计数，
+//                    仅每65536个脉冲(或到达目标水量)进一次中断，适合高频传感器；
+//                    P1.0不再输出模拟方波
+#define FLOW_BACKEND_INT0 0
+#define FLOW_BACKEND_T2   1
+#ifndef FLOW_BACKEND
+#define FLOW_BACKEND FLOW_BACKEND_INT0
+#endif
+
 /*
  * - T0使用50ms定时，产生10Hz基频
  * - 软件2分频，输出5Hz方波
@@ -24,7 +35,9 @@ void FlowMeter_Init(void);              // 初始化流量计
 void FlowMeter_Start(void);             // 启动流量计
 void FlowMeter_Stop(void);              // 停止流量计
 void FlowMeter_Reset(void);             // 复位流量计累计值
+void FlowMeter_SetTarget(WORD ml);      // 设置本次目标水量，到达时中断内关阀(0=不限)
 void FlowMeter_CalcFlow(void);          // 计算流量（每秒调用一次）
+void FlowMeter_UpdateRate(void);        // 按脉冲周期更新流速（在主循环中调用）
 void FlowMeter_DisplayCurrent(void);    // 显示当前流量
 void FlowMeter_DisplayTotal(void);      // 显示累计流量
 void FlowMeter_SetMode(BYTE mode);      // 设置流量显示模式
@@ -33,7 +46,7 @@ WORD FlowMeter_GetCurrentFlow(void);    // 获取当前流量（毫升/秒）
 unsigned long FlowMeter_GetTotalFlow(void); // 获取累计流量（毫升）
 void UpdateCurrentFlowDisplay(void);    // 更新当前流量显示（毫升/秒）
 void UpdateTotalFlowDisplay(void);      // 更新累计流量显示（毫升）
-void FlowMeter_UpdateDisplay(void);     // 检查并更新显示（在主循环中调用）
+void FlowMeter_UpdateDisplay(void);     // 绘制流量视图（由 Display_Render 调用）
 
 // 24C02存储相关函数
 void SaveTotalFlowToEEPROM(void);       // 保存累计流量到24C02
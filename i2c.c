@@ -1,113 +1,572 @@
 #include "i2c.h"
 #include "intrins.h"
+#include "power.h"
 
 unsigned long xdata totalFlow = 0; 
 
+// 写请求队列
+typedef struct {
+    BYTE addr;
+    BYTE len;
+    BYTE dat[EEPROM_PAGE_SIZE];
+} EEPROM_JOB;
+
+static EEPROM_JOB xdata ee_job[EEPROM_JOB_NUM];
+static BYTE ee_job_count = 0;       // 队列中等待发送的请求数
+static bit ee_writing = 0;          // 等待24C02应答(内部写周期或重发前)
+static bit ee_cycle = 0;            // 上次发送被接受，等待的是真实写周期
+static WORD ee_write_start;         // 发送结束时的PCA计数
+static WORD xdata ee_cycle_last = 0;    // 最近一次观测到的写周期(PCA计数)
+static WORD xdata ee_cycle_max = 0;     // 最长写周期(PCA计数)
+static WORD xdata ee_timeouts = 0;      // 超时仍不应答的次数
+static BYTE ee_retry = 0;           // 队首请求已重发次数
+static bit ee_busy_poll = 0;        // 等待写周期时连续查询应答，不进入空闲(掉电处理中)
+
+// 设置区影子：上电一次连续读入，之后读取不访问总线；写入只改影子并
+// 标记所在页，按 EEPROM_Second 的策略或 EEPROM_Flush 整页写回
+static BYTE xdata ee_shadow[EE_SHADOW_SIZE];
+static BYTE ee_dirty = 0;           // 已修改未写回的页(位号为页号)
+static bit ee_flush_req = 0;        // 写回已请求，写引擎空闲时逐页提交
+static BYTE xdata ee_quiet = 0;     // 最近一次修改后经过的秒数
+static BYTE xdata ee_dirty_age = 0; // 最早的未写回修改经过的秒数
+
+// 累计流量日志状态
+static unsigned long xdata flow_seq = 0;    // 最新记录序号(0表示尚无记录)
+
+// 半个SCL周期需要的机器周期数；置位/清零引脚及其前后的指令至少占1~2个周期
+#define I2C_HALF_CYCLES  ((FOSC / I2C_CPU_CLOCKS / 1000 / I2C_KHZ + 1) / 2)
+#if I2C_HALF_CYCLES <= 2
+#define I2C_DELAY()                         // 指令本身已够半周期
+#elif I2C_HALF_CYCLES <= 6
+#define I2C_DELAY()  { _nop_(); _nop_(); _nop_(); _nop_(); }
+#else
+#define I2C_DELAY()  { BYTE i2c_n = I2C_HALF_CYCLES / 2; while(--i2c_n); }  // DJNZ至少2个周期
+#endif
+
+static WORD xdata i2c_errors = 0;   // 重试后仍失败的传输次数
+
+static void I2C_CountError(void) {
+    if(i2c_errors != 0xFFFF) {
+        i2c_errors++;
+    }
+}
+
+WORD I2C_GetErrors(void) {
+    return i2c_errors;
+}
+
 void I2C_Start() {
-    SDA = 1; _nop_();
-    SCL = 1; _nop_();
-    SDA = 0; _nop_();
-    SCL = 0; _nop_();
+    SDA = 1; I2C_DELAY();
+    SCL = 1; I2C_DELAY();
+    SDA = 0; I2C_DELAY();
+    SCL = 0; I2C_DELAY();
 }
 
 void I2C_Stop() {
-    SDA = 0; _nop_();
-    SCL = 1; _nop_();
-    SDA = 1; _nop_();
+    SDA = 0; I2C_DELAY();
+    SCL = 1; I2C_DELAY();
+    SDA = 1; I2C_DELAY();
 }
 
 //ack 0:应答 1:非应答
 
 void I2C_SendAck(bit ack) {
-    SDA = ack; _nop_();
-    SCL = 1; _nop_();
-    SCL = 0; _nop_();
-    SDA = 1; _nop_();
+    SDA = ack; I2C_DELAY();
+    SCL = 1; I2C_DELAY();
+    SCL = 0; I2C_DELAY();
+    SDA = 1;
 }
 
 // 0:应答成功 1:应答失败
 
 bit I2C_WaitAck() {
-    SDA = 1; _nop_();
-    SCL = 1; _nop_();
-    if(SDA) { // 应答失败
-        SCL = 0; _nop_();
-        return 1;
-    }
-    SCL = 0; _nop_();
-    return 0;
+    bit nack;
+    
+    SDA = 1; I2C_DELAY();
+    SCL = 1; I2C_DELAY();
+    nack = SDA;
+    SCL = 0; I2C_DELAY();
+    return nack;
 }
 
-void I2C_WriteByte(unsigned char dat) {
+bit I2C_WriteByte(unsigned char dat) {
     unsigned char i;
     for(i=0; i<8; i++) {
         SDA = (dat & 0x80) ? 1 : 0;
-        SCL = 1; _nop_();
-        SCL = 0; _nop_();
+        SCL = 1; I2C_DELAY();
+        SCL = 0; I2C_DELAY();
         dat <<= 1;
     }
-    I2C_WaitAck();
+    return I2C_WaitAck();
 }
 
 unsigned char I2C_ReadByte(bit ack) {
     unsigned char i, dat = 0;
     SDA = 1;
     for(i=0; i<8; i++) {
-        SCL = 1; _nop_();
+        SCL = 1; I2C_DELAY();
         dat <<= 1;
         dat |= SDA;
-        SCL = 0; _nop_();
+        SCL = 0; I2C_DELAY();
     }
     I2C_SendAck(ack);
     return dat;
 }
 
-void EEPROM_WriteULong(unsigned char addr, unsigned long dat) {
-    I2C_Start();
-    I2C_WriteByte(EEPROM_ADDR);    // 器件地址+写
-    I2C_WriteByte(addr);           // 存储地址
-    
-    // 分4次写入，从低字节到高字节
-    I2C_WriteByte((unsigned char)(dat & 0xFF));
-    I2C_WriteByte((unsigned char)((dat >> 8) & 0xFF));
-    I2C_WriteByte((unsigned char)((dat >> 16) & 0xFF));
-    I2C_WriteByte((unsigned char)((dat >> 24) & 0xFF));
+// 总线恢复：主机复位时从机可能正在输出数据位并拉住SDA。
+// 最多补9个时钟让它把当前字节送完，再发起始+停止信号复位从机状态机
+void I2C_Recover(void) {
+    BYTE i;
     
+    SDA = 1;
+    SCL = 1; I2C_DELAY();
+    for(i = 0; i < 9 && !SDA; i++) {
+        SCL = 0; I2C_DELAY();
+        SCL = 1; I2C_DELAY();
+    }
+    I2C_Start();
     I2C_Stop();
-    delay_ms(20);                  // 写入时间
 }
 
-unsigned long EEPROM_ReadULong(unsigned char addr) {
-    unsigned long dat = 0;
+// 发送队首请求，24C02随后进入内部写周期
+// 任何一个字节不应答时保留请求，等一个写周期后重发，超过 I2C_RETRIES 次丢弃
+static void EEPROM_StartJob(void) {
+    BYTE i;
+    bit nack;
+    
     I2C_Start();
-    I2C_WriteByte(EEPROM_ADDR);    // 器件地址+写
-    I2C_WriteByte(addr);           // 存储地址
+    nack = I2C_WriteByte(EEPROM_ADDR);             // 器件地址+写
+    if(!nack) {
+        nack = I2C_WriteByte(ee_job[0].addr);      // 存储地址
+    }
+    for(i = 0; !nack && i < ee_job[0].len; i++) {
+        nack = I2C_WriteByte(ee_job[0].dat[i]);
+    }
+    I2C_Stop();
+    
+    ee_write_start = PCA_Now();
+    ee_writing = 1;
+    ee_cycle = !nack;
+    
+    if(nack) {
+        if(++ee_retry <= I2C_RETRIES) {
+            return;
+        }
+        I2C_CountError();
+    }
+    ee_retry = 0;
+    
+    // 队列前移
+    ee_job_count--;
+    for(i = 0; i < ee_job_count; i++) {
+        ee_job[i] = ee_job[i + 1];
+    }
+}
 
+// 写回影子区编号最小的脏页(写引擎空闲时调用)
+static void EEPROM_WritePage(void) {
+    BYTE i, m, addr;
+    
+    for(addr = 0, m = 1; !(ee_dirty & m); addr += EEPROM_PAGE_SIZE, m <<= 1) {
+    }
+    ee_dirty &= ~m;
+    ee_job[0].addr = addr;
+    ee_job[0].len = EEPROM_PAGE_SIZE;
+    for(i = 0; i < EEPROM_PAGE_SIZE; i++) {
+        ee_job[0].dat[i] = ee_shadow[addr + i];
+    }
+    ee_job_count = 1;
+    EEPROM_StartJob();
+}
+
+// 影子区一页立即提交：清除脏位，作为普通写请求排队
+void EEPROM_CommitPage(BYTE addr) {
+    BYTE m;
+    
+    addr &= ~(EEPROM_PAGE_SIZE - 1);
+    if(addr >= EE_SHADOW_SIZE) {
+        return;
+    }
+    m = 1 << (addr / EEPROM_PAGE_SIZE);
+    if(!(ee_dirty & m)) {
+        return;                    // 与器件内容相同或已提交
+    }
+    ee_dirty &= ~m;
+    EEPROM_WriteAsync(addr, ee_shadow + addr, EEPROM_PAGE_SIZE);
+}
+
+// 应答查询：写周期内24C02不应答器件地址，只发地址不发数据不会引起写入
+static bit EEPROM_Ready(void) {
+    bit nack;
+    
     I2C_Start();
-    I2C_WriteByte(EEPROM_ADDR|1);  // 器件地址+读
+    nack = I2C_WriteByte(EEPROM_ADDR);
+    I2C_Stop();
+    return !nack;
+}
+
+// 等待写周期的间隙：平时进入空闲，下一个中断(数码管扫描约1ms)后再查询；
+// 掉电处理中扫描中断已停，只剩10ms节拍，改为直接返回连续查询
+static void EEPROM_Idle(void) {
+    if(!ee_busy_poll) {
+        PCON |= 0x01;
+    }
+}
+
+void EEPROM_BusyPoll(bit on) {
+    ee_busy_poll = on;
+}
+
+// 推进写引擎：器件应答(写周期结束)后发送下一个请求
+// 观测到的写周期包含查询间隔，主循环中约10ms一次，EEPROM_Flush 中约1ms一次
+void EEPROM_Poll(void) {
+    WORD t;
     
-    // 分4次读取，从低字节到高字节
-    dat = I2C_ReadByte(0);         // 读取低字节(发送应答)
-    dat |= (unsigned long)I2C_ReadByte(0) << 8;
-    dat |= (unsigned long)I2C_ReadByte(0) << 16;
-    dat |= (unsigned long)I2C_ReadByte(1) << 24; // 最后一个字节发送非应答
+    if(ee_writing) {
+        t = PCA_Now() - ee_write_start;
+        if(!EEPROM_Ready()) {
+            if(t < EEPROM_WRITE_TIMEOUT) {
+                return;
+            }
+            if(ee_timeouts != 0xFFFF) {
+                ee_timeouts++;     // 不再等待，队首请求按重发处理
+            }
+        } else if(ee_cycle) {
+            ee_cycle_last = t;
+            if(t > ee_cycle_max) {
+                ee_cycle_max = t;
+            }
+        }
+        ee_writing = 0;
+    }
+    if(ee_job_count > 0) {
+        EEPROM_StartJob();
+    } else if(ee_flush_req) {
+        if(ee_dirty) {
+            EEPROM_WritePage();
+        } else {
+            ee_flush_req = 0;
+        }
+    }
+}
+
+// PCA计数换算为微秒(每计数12个时钟)
+static WORD CountsToUs(WORD counts) {
+    return (WORD)((unsigned long)counts * 12000 / (FOSC / 1000));
+}
+
+WORD EEPROM_GetCycleLast(void) {
+    return CountsToUs(ee_cycle_last);
+}
+
+WORD EEPROM_GetCycleMax(void) {
+    return CountsToUs(ee_cycle_max);
+}
+
+WORD EEPROM_GetTimeouts(void) {
+    return ee_timeouts;
+}
+
+bit EEPROM_IsBusy(void) {
+    return ee_writing || ee_job_count > 0 || (ee_flush_req && ee_dirty);
+}
+
+// 等待已提交的写入完成，读总线前调用
+static void EEPROM_WaitIdle(void) {
+    while(ee_writing || ee_job_count > 0) {
+        POWER_FAIL_CHECK();
+        EEPROM_Poll();
+        if(ee_writing) {
+            EEPROM_Idle();
+        }
+    }
+}
+
+// 强制写回：影子区的脏页全部写入器件后返回
+void EEPROM_Flush(void) {
+    ee_flush_req = 1;
+    while(EEPROM_IsBusy()) {
+        POWER_FAIL_CHECK();        // Power_Fail 放弃写回请求，本函数随之返回
+        EEPROM_Poll();
+        if(ee_writing) {
+            EEPROM_Idle();
+        }
+    }
+}
+
+// 掉电：不再开始影子区写回(脏页留给写回策略，电压恢复后照常写入)，只等待
+// 正在进行的写周期和队列中的请求完成，最多 1+EEPROM_JOB_NUM 个写周期
+void EEPROM_Drain(void) {
+    ee_flush_req = 0;
+    while(ee_writing || ee_job_count > 0) {
+        EEPROM_Poll();
+        if(ee_writing) {
+            EEPROM_Idle();
+        }
+    }
+}
+
+// 写回策略(每秒调用)：停止修改 EE_FLUSH_IDLE_SEC 秒后写回；
+// 一直有修改时(如按住增减键)最迟 EE_FLUSH_MAX_SEC 秒写回一次
+void EEPROM_Second(void) {
+    if(!ee_dirty) {
+        return;
+    }
+    if(ee_quiet != 0xFF) {
+        ee_quiet++;
+    }
+    if(ee_dirty_age != 0xFF) {
+        ee_dirty_age++;
+    }
+    if(ee_quiet >= EE_FLUSH_IDLE_SEC || ee_dirty_age >= EE_FLUSH_MAX_SEC) {
+        ee_flush_req = 1;
+    }
+}
+
+// 提交写请求，立即返回(直接写器件，不经过影子区，用于日志区和 EEPROM_CommitPage)
+// 同一地址尚未发送的请求直接用新数据覆盖；队列满时先等待一个写周期
+void EEPROM_WriteAsync(BYTE addr, BYTE *dat, BYTE len) {
+    BYTE i, n;
+    
+    if(len == 0 || (addr % EEPROM_PAGE_SIZE) + len > EEPROM_PAGE_SIZE) {
+        return;                    // 跨页写入会在页内回卷，拒绝
+    }
+    
+    for(n = 0; n < ee_job_count; n++) {
+        if(ee_job[n].addr == addr && ee_job[n].len == len) {
+            break;
+        }
+    }
+    if(n == ee_job_count) {
+        while(ee_job_count >= EEPROM_JOB_NUM) {
+            EEPROM_Poll();
+            if(ee_job_count >= EEPROM_JOB_NUM) {
+                EEPROM_Idle();
+            }
+        }
+        n = ee_job_count++;
+        ee_job[n].addr = addr;
+        ee_job[n].len = len;
+    }
+    for(i = 0; i < len; i++) {
+        ee_job[n].dat[i] = dat[i];
+    }
+    
+    EEPROM_Poll();                 // 总线空闲时立即发送
+}
+
+// 任意长度写入：影子区内只改内存，内容有变化的页标记待写回；
+// 影子区外按页边界拆成多个写请求
+void EEPROM_WriteBuf(BYTE addr, BYTE *buf, BYTE len) {
+    BYTE n;
+    
+    for(; len && addr < EE_SHADOW_SIZE; addr++, buf++, len--) {
+        if(ee_shadow[addr] != *buf) {
+            ee_shadow[addr] = *buf;
+            if(!ee_dirty) {
+                ee_dirty_age = 0;
+            }
+            ee_dirty |= 1 << (addr / EEPROM_PAGE_SIZE);
+            ee_quiet = 0;
+        }
+    }
+    while(len) {
+        n = EEPROM_PAGE_SIZE - (addr % EEPROM_PAGE_SIZE);
+        if(n > len) {
+            n = len;
+        }
+        EEPROM_WriteAsync(addr, buf, n);
+        addr += n;
+        buf += n;
+        len -= n;
+    }
+}
+
+void EEPROM_Write(unsigned char addr, unsigned char dat) {
+    EEPROM_WriteBuf(addr, &dat, 1);
+}
+
+// 连续读的地址阶段：写入存储地址后重复起始，切换为读
+// 任何一个字节不应答都从起始信号重来；用尽重试后恢复总线并返回1
+bit EEPROM_ReadBegin(BYTE addr) {
+    BYTE n;
     
+    EEPROM_WaitIdle();             // 写周期内器件不应答
+    for(n = 0; n <= I2C_RETRIES; n++) {
+        I2C_Start();
+        if(!I2C_WriteByte(EEPROM_ADDR) && !I2C_WriteByte(addr)) {
+            I2C_Start();
+            if(!I2C_WriteByte(EEPROM_ADDR | 1)) {
+                return 0;
+            }
+        }
+        I2C_Stop();
+    }
+    I2C_CountError();
+    I2C_Recover();
+    return 1;
+}
+
+// 连续读：地址在器件内自动递增，可跨页
+static bit EEPROM_ReadBus(BYTE addr, BYTE *buf, BYTE len) {
+    if(len == 0) {
+        return 0;
+    }
+    if(EEPROM_ReadBegin(addr)) {
+        return 1;
+    }
+    while(--len) {
+        *buf++ = I2C_ReadByte(0);
+    }
+    *buf = I2C_ReadByte(1);        // 最后一个字节发送非应答
     I2C_Stop();
+    return 0;
+}
+
+// 只取影子区内的部分，不访问总线，也就不会等待写周期(掉电处理中使用)
+void EEPROM_ReadShadow(BYTE addr, BYTE *buf, BYTE len) {
+    for(; len && addr < EE_SHADOW_SIZE; addr++, len--) {
+        *buf++ = ee_shadow[addr];
+    }
+}
+
+// 影子区内的部分直接从内存取，其余一次连续读
+bit EEPROM_ReadBuf(BYTE addr, BYTE *buf, BYTE len) {
+    for(; len && addr < EE_SHADOW_SIZE; addr++, len--) {
+        *buf++ = ee_shadow[addr];
+    }
+    return EEPROM_ReadBus(addr, buf, len);
+}
+
+unsigned char EEPROM_Read(unsigned char addr) {
+    BYTE dat;
+    
+    if(EEPROM_ReadBuf(addr, &dat, 1)) {
+        return 0xFF;               // 读失败按擦除状态处理
+    }
     return dat;
 }
 
-// I2C初始化
+void EEPROM_WriteULong(unsigned char addr, unsigned long dat) {
+    BYTE buf[4];
+    
+    // 从低字节到高字节
+    buf[0] = (unsigned char)(dat & 0xFF);
+    buf[1] = (unsigned char)((dat >> 8) & 0xFF);
+    buf[2] = (unsigned char)((dat >> 16) & 0xFF);
+    buf[3] = (unsigned char)((dat >> 24) & 0xFF);
+    EEPROM_WriteBuf(addr, buf, 4);
+}
+
+// 读失败返回0xFFFFFFFF(与擦除状态相同)
+unsigned long EEPROM_ReadULong(unsigned char addr) {
+    BYTE buf[4];
+    
+    if(EEPROM_ReadBuf(addr, buf, 4)) {
+        return 0xFFFFFFFFUL;
+    }
+    // 从低字节到高字节
+    return buf[0] | ((unsigned long)buf[1] << 8) |
+           ((unsigned long)buf[2] << 16) | ((unsigned long)buf[3] << 24);
+}
+
+// I2C初始化：恢复总线后一次连续读入影子区，读失败按擦除状态处理
 void I2C_Init(void) {
-    SDA = 1;
-    SCL = 1;
+    BYTE i;
+    
+    I2C_Recover();
+    ee_dirty = 0;
+    ee_flush_req = 0;
+    if(EEPROM_ReadBus(0, ee_shadow, EE_SHADOW_SIZE)) {
+        for(i = 0; i < EE_SHADOW_SIZE; i++) {
+            ee_shadow[i] = 0xFF;
+        }
+    }
 }
 
-// 写累计流量到24C02（兼容）
+// 记录校验：前7字节求和取反，全0xFF(擦除)和全0都不能通过
+static BYTE FlowLog_Checksum(BYTE *rec) {
+    BYTE i, sum = 0;
+    for(i = 0; i < FLOW_LOG_SIZE - 1; i++) {
+        sum += rec[i];
+    }
+    return ~sum;
+}
+
+// 写累计流量到24C02：写入下一个槽位，旧记录保留到被轮转覆盖
 void AT24C02_WriteTotalFlow(unsigned long flow) {
-    EEPROM_WriteULong(TOTAL_FLOW_ADDR_0, flow);
+    BYTE rec[FLOW_LOG_SIZE];
+    BYTE slot;
+    
+    flow_seq = (flow_seq + 1) & FLOW_LOG_SEQ_MASK;
+    if(flow_seq == 0) {
+        flow_seq = 1;                  // 0保留给“无记录”
+    }
+    slot = (BYTE)(flow_seq % FLOW_LOG_SLOTS);
+    
+    rec[0] = (BYTE)flow_seq;
+    rec[1] = (BYTE)(flow_seq >> 8);
+    rec[2] = (BYTE)(flow_seq >> 16);
+    rec[3] = (BYTE)flow;
+    rec[4] = (BYTE)(flow >> 8);
+    rec[5] = (BYTE)(flow >> 16);
+    rec[6] = (BYTE)(flow >> 24);
+    rec[7] = FlowLog_Checksum(rec);
+    
+    EEPROM_WriteAsync(FLOW_LOG_ADDR + slot * FLOW_LOG_SIZE, rec, FLOW_LOG_SIZE);
 }
 
-// 从24C02读累计流量（兼容）
+// 从24C02读累计流量：一次连续读出整个日志区，取序号最新的有效记录
+// 写入中掉电的记录校验失败被跳过，退回上一条
 unsigned long AT24C02_ReadTotalFlow(void) {
-    return EEPROM_ReadULong(TOTAL_FLOW_ADDR_0);
+    BYTE rec[FLOW_LOG_SIZE];
+    BYTE slot, i;
+    unsigned long seq, flow = 0;
+    bit found = 0;
+    
+    if(EEPROM_ReadBegin(FLOW_LOG_ADDR)) {
+        return 0;                      // 总线故障，从0开始计
+    }
+    
+    for(slot = 0; slot < FLOW_LOG_SLOTS; slot++) {
+        for(i = 0; i < FLOW_LOG_SIZE; i++) {
+            // 最后一个字节发送非应答
+            rec[i] = I2C_ReadByte(slot == FLOW_LOG_SLOTS - 1 && i == FLOW_LOG_SIZE - 1);
+        }
+        
+        if(rec[7] != FlowLog_Checksum(rec)) {
+            continue;
+        }
+        seq = rec[0] | ((unsigned long)rec[1] << 8) | ((unsigned long)rec[2] << 16);
+        if(seq == 0) {
+            continue;
+        }
+        // 序号差值小于一半范围视为更新(兼容回绕)
+        if(!found || (((seq - flow_seq) & FLOW_LOG_SEQ_MASK) < (FLOW_LOG_SEQ_MASK >> 1))) {
+            flow_seq = seq;
+            flow = rec[3] | ((unsigned long)rec[4] << 8) |
+                   ((unsigned long)rec[5] << 16) | ((unsigned long)rec[6] << 24);
+            found = 1;
+        }
+    }
+    I2C_Stop();
+    
+    if(!found) {
+        // 日志区无有效记录：读取旧版本地址，擦除状态视为0
+        flow_seq = 0;
+        flow = EEPROM_ReadULong(TOTAL_FLOW_ADDR_0);
+        if(flow == 0xFFFFFFFFUL) {
+            flow = 0;
+        }
+    }
+    return flow;
+}
+
+// 日志区累计写入次数，每个槽位的写入次数约为其1/FLOW_LOG_SLOTS
+unsigned long AT24C02_GetFlowWrites(void) {
+    return flow_seq;
+}
+
+BYTE AT24C02_GetFlowSlot(void) {
+    return (BYTE)(flow_seq % FLOW_LOG_SLOTS);
 }
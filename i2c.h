@@ -8,11 +8,22 @@
 sbit SDA = P2^5;  // I2C数据线
 sbit SCL = P2^6;  // I2C时钟线
 
+// 总线时序在编译时由晶振、每机器周期时钟数和目标速率决定：
+// 12T(STC89)在11.0592MHz下指令本身已慢于400kHz，不插延时；
+// 1T(STC12/15)按半周期插入空操作或计数循环
+#ifndef I2C_CPU_CLOCKS
+#define I2C_CPU_CLOCKS  12      // 每机器周期时钟数：12(12T) 或 1(1T)
+#endif
+#ifndef I2C_KHZ
+#define I2C_KHZ         400     // SCL频率(kHz)，24C02在5V下支持400kHz
+#endif
+#define I2C_RETRIES     3       // 器件不应答时的重试次数
+
 // 24C02参数定义
 #define AT24C02_ADDR 0xA0  // 24C02器件地址
 #define EEPROM_ADDR 0xA0   // 兼容
 
-// 累计流量存储地址定义
+// 累计流量存储地址定义(旧版本原地写入，仅用于升级后首次读取)
 #define TOTAL_FLOW_ADDR_0 0x00  // 累计流量低字节
 #define TOTAL_FLOW_ADDR_1 0x01  // 累计流量第2字节
 #define TOTAL_FLOW_ADDR_2 0x02  // 累计流量第3字节
@@ -23,38 +34,78 @@ sbit SCL = P2^6;  // I2C时钟线
 #define EEPROM_MIN_ADR 0x11     // 闹钟分钟存储地址
 #define EEPROM_SEC_ADR 0x12     // 闹钟秒存储地址
 #define EEPROM_WATER_ADR 0x04   // 浇水量存储起始地址(4字节)
-#define INIT_FLAG_ADDR 0x20     // 初始化标志地址
+#define INIT_FLAG_ADDR 0x20     // 初始化标志地址(配置块标识字节)
 #define INIT_FLAG_VALUE 0x55    // 初始化标志值
 
+// 浇水会话(keyboard_control.c)：浇水中掉电时，上电据此补出浇水记录。
+// 每次浇水换下一页，在设置区的4个空闲页间轮转
+#define SESSION_SLOTS     4
+#define SESSION_PAGE_0    0x08
+#define SESSION_PAGE_1    0x18
+#define SESSION_PAGE_2    0x30
+#define SESSION_PAGE_3    0x38
+
+// 累计流量日志区：每条记录占一页，按序号轮转写入各槽位
+// 记录格式：序号(3字节) + 累计流量(4字节) + 校验(1字节)
+#define FLOW_LOG_ADDR   0x40    // 日志区起始地址(页对齐)
+#define FLOW_LOG_SLOTS  24      // 槽位数(0x40~0xFF)
+#define FLOW_LOG_SIZE   8       // 每条记录字节数(等于页大小)
+#define FLOW_LOG_SEQ_MASK 0xFFFFFFUL  // 序号为24位，回绕后按差值比较新旧
+
+// 异步写引擎：提交后立即返回，主循环 EEPROM_Poll 查询器件应答判断写周期结束
+#define EEPROM_PAGE_SIZE   8    // 24C02页大小，单次写入不能跨页
+#define EEPROM_JOB_NUM     2    // 写请求队列深度
+#define EEPROM_WRITE_TIMEOUT (FOSC / 12 / 1000 * 20)  // 应答查询超时20ms(PCA计数，规格最大10ms)
+
+// 影子区：设置区 0x00~0x3F 在 xdata 中的副本(8页，每页一个脏位)。
+// EEPROM_Read/Write/ReadBuf/WriteBuf/ReadULong/WriteULong 落在此区的部分
+// 只访问内存；日志区本身轮转写入，不缓存
+#define EE_SHADOW_SIZE     0x40  // 必须为页大小的整数倍且不超过 FLOW_LOG_ADDR
+#define EE_FLUSH_IDLE_SEC  3     // 最后一次修改后3秒写回
+#define EE_FLUSH_MAX_SEC   30    // 持续修改时最迟30秒写回
+
 
 void I2C_Start(void);                          // 发送起始信号
 void I2C_Stop(void);                           // 发送停止信号
 void I2C_SendAck(bit ack);                     // 发送应答信号
-bit I2C_WaitAck(void);                         // 等待应答信号
-void I2C_WriteByte(unsigned char dat);         // 写一个字节
+bit I2C_WaitAck(void);                         // 等待应答信号(0:应答 1:非应答)
+bit I2C_WriteByte(unsigned char dat);          // 写一个字节，返回值同 I2C_WaitAck
 unsigned char I2C_ReadByte(bit ack);           // 读一个字节
+void I2C_Recover(void);                        // SDA被从机拉住时补发时钟并发停止信号
+WORD I2C_GetErrors(void);                      // 重试后仍失败的传输次数
 
 // 24C02操作函数声明
-void EEPROM_Write(unsigned char addr, unsigned char dat);  // 向24C02写数据
-unsigned char EEPROM_Read(unsigned char addr); // 从24C02读数据
-void EEPROM_WriteULong(unsigned char addr, unsigned long dat); // 写unsigned long数据
+void EEPROM_Write(unsigned char addr, unsigned char dat);  // 向24C02写一个字节(异步)
+unsigned char EEPROM_Read(unsigned char addr); // 从24C02读一个字节，失败返回0xFF
+bit EEPROM_ReadBegin(BYTE addr);               // 开始连续读(之后 I2C_ReadByte，最后一字节非应答再 I2C_Stop)，失败返回1
+bit EEPROM_ReadBuf(BYTE addr, BYTE *buf, BYTE len); // 连续读，失败返回1
+void EEPROM_ReadShadow(BYTE addr, BYTE *buf, BYTE len); // 只读影子区，不访问总线
+void EEPROM_WriteBuf(BYTE addr, BYTE *buf, BYTE len); // 按页拆分后提交写请求(异步)
+void EEPROM_WriteULong(unsigned char addr, unsigned long dat); // 写unsigned long数据(异步)
 unsigned long EEPROM_ReadULong(unsigned char addr);       // 读unsigned long数据
-bit IsFirstPowerOn(void);                      // 检测是否为第一次上电
-void SetInitializedFlag(void);                 // 标记已初始化
-
-void I2C_Init(void);                           // I2C初始化
-bit I2C_SendByte(BYTE dat);                    // 发送一个字节(兼容)
-BYTE I2C_ReceiveByte(bit ack);                 // 接收一个字节(兼容)
-void AT24C02_WriteByte(BYTE addr, BYTE dat);   // 写一个字节到24C02
-BYTE AT24C02_ReadByte(BYTE addr);              // 从24C02读一个字节
-void AT24C02_WriteTotalFlow(unsigned long flow); // 写累计流量到24C02
-unsigned long AT24C02_ReadTotalFlow(void);    // 从24C02读累计流量
+void EEPROM_WriteAsync(BYTE addr, BYTE *dat, BYTE len);  // 提交写请求(不跨页)
+void EEPROM_Poll(void);                        // 推进写引擎(主循环中调用)
+bit EEPROM_IsBusy(void);                       // 是否有未完成的写入
+WORD EEPROM_GetCycleLast(void);                // 最近一次写周期(微秒，含查询间隔)
+WORD EEPROM_GetCycleMax(void);                 // 最长写周期(微秒)
+WORD EEPROM_GetTimeouts(void);                 // 写周期超时次数
+void EEPROM_Flush(void);                       // 强制写回影子区并等待所有写入完成
+void EEPROM_Drain(void);                       // 只等待已提交的写入完成(掉电时用)
+void EEPROM_BusyPoll(bit on);                  // 1=等待写周期时连续查询，不进入空闲
+void EEPROM_CommitPage(BYTE addr);             // 影子区中该页有修改时立即提交写入(不等写回策略)
+void EEPROM_Second(void);                      // 秒事件：影子区写回策略
 
+void I2C_Init(void);                           // I2C初始化(含总线恢复)，读入影子区
+#define I2C_SendByte(dat)       I2C_WriteByte(dat)      // 兼容
+#define I2C_ReceiveByte(ack)    I2C_ReadByte(ack)       // 兼容
+#define AT24C02_WriteByte(addr, dat)  EEPROM_Write(addr, dat)  // 写一个字节到24C02
+#define AT24C02_ReadByte(addr)  EEPROM_Read(addr)       // 从24C02读一个字节
+void AT24C02_WriteTotalFlow(unsigned long flow); // 写累计流量到24C02
+unsigned long AT24C02_ReadTotalFlow(void);    // 从24C02读累计流量(启动时扫描日志区)
+unsigned long AT24C02_GetFlowWrites(void);    // 日志区累计写入次数
+BYTE AT24C02_GetFlowSlot(void);                // 最新记录所在槽位
 
-void SaveAlarmToEEPROM(void);                  // 保存闹钟时间到EEPROM
-void ReadAlarmFromEEPROM(void);                // 从EEPROM读取闹钟时间
-void SaveWateringToEEPROM(void);               // 保存浇水量到EEPROM
-void ReadWateringFromEEPROM(void);             // 从EEPROM读取浇水量
+// 浇水日程、闹钟时间及初始化标志的读写见 config.h(配置块)
 
 // 外部变量声明
 extern unsigned long xdata totalFlow;
@@ -0,0 +1,90 @@
+#include "key.h"
+#include "power.h"
+
+sbit KEY_SET_PIN = P3^3;
+
+BYTE key_state = 0;
+static BYTE keyCt0 = 0xFF;        // 垂直计数器低位
+static BYTE keyCt1 = 0xFF;        // 垂直计数器高位
+static BYTE keyHeld = KEY_ID_NONE;  // 正在计时的键
+static BYTE keyHoldTicks = 0;     // 按住时长(饱和于255)
+static BYTE keyRepeatTicks = 0;   // 距下次连发的节拍数
+static BYTE xdata keyRepeatCount = 0;  // 本次按住已处理的连发次数(主循环用)
+
+void Key_Init(void) {
+    P1 |= 0xFC;                   // P1.2~P1.7 准双向口写1作输入
+    KEY_SET_PIN = 1;
+    key_state = 0;
+    keyCt0 = 0xFF;
+    keyCt1 = 0xFF;
+    keyHeld = KEY_ID_NONE;
+}
+
+// 每10ms调用一次
+// 垂直计数器：每个键在 ct1:ct0 中各占一位，组成2位计数器；采样与状态相同
+// 时复位，连续4次不同时状态翻转。7个键的计数用几条字节运算一起完成
+void Key_Tick(void) {
+    BYTE sample, changed, k, m;
+
+    sample = (BYTE)(~P1) >> 2;    // 低电平为按下
+#if POWER_FAIL != POWER_FAIL_INT1
+    if(!KEY_SET_PIN) {
+        sample |= 1 << KEY_ID_SET;
+    }
+#endif
+
+    changed = key_state ^ sample;
+    keyCt0 = ~(keyCt0 & changed);
+    keyCt1 = keyCt0 ^ (keyCt1 & changed);
+    changed &= keyCt0 & keyCt1;   // 计满的位
+    key_state ^= changed;
+
+    // 状态变化很少，逐位处理
+    if(changed) {
+        for(k = 0, m = 1; k < KEY_COUNT; k++, m <<= 1) {
+            if(!(changed & m)) {
+                continue;
+            }
+            if(key_state & m) {
+                EVENT_POST(KEY_EVENT(KEY_EVT_PRESS, k));
+                keyHeld = k;      // 新按下的键接管长按计时
+                keyHoldTicks = 0;
+                keyRepeatTicks = KEY_REPEAT_DELAY;
+            } else {
+                EVENT_POST(KEY_EVENT(KEY_EVT_RELEASE, k));
+                if(keyHeld == k) {
+                    keyHeld = KEY_ID_NONE;
+                }
+            }
+        }
+    }
+
+    if(keyHeld != KEY_ID_NONE) {
+        if(keyHoldTicks != 0xFF && ++keyHoldTicks == KEY_LONG_TICKS) {
+            EVENT_POST(KEY_EVENT(KEY_EVT_LONG, keyHeld));
+        }
+        if(--keyRepeatTicks == 0) {
+            keyRepeatTicks = KEY_REPEAT_TICKS;
+            EVENT_POST(KEY_EVENT(KEY_EVT_REPEAT, keyHeld));
+        }
+    }
+}
+
+// 按住越久步长越大：按下和前几次连发为1，之后10，再之后100
+// 连发只来自最近按下的键，按下事件清零计数即可
+BYTE Key_Step(BYTE evt) {
+    if(KEY_EVT_KIND(evt) == KEY_EVT_PRESS) {
+        keyRepeatCount = 0;
+        return 1;
+    }
+    if(keyRepeatCount != 0xFF) {
+        keyRepeatCount++;
+    }
+    if(keyRepeatCount > KEY_ACCEL_100) {
+        return 100;
+    }
+    if(keyRepeatCount > KEY_ACCEL_10) {
+        return 10;
+    }
+    return 1;
+}
@@ -0,0 +1,53 @@
+#ifndef __KEY_H__
+#define __KEY_H__
+
+#include "reg51.h"
+#include "pca.h"
+#include "event.h"
+
+/*
+ * 按键消抖：PCA 100Hz 节拍中采样 P1.2~P1.7 和 P3.3
+ * - 7个键并行消抖(2位垂直计数器)，连续4次采样一致才改变状态，约30~40ms
+ * - 状态变化、长按、连发由中断投递到事件队列，主循环不再等待或延时
+ * - 长按和连发只对最近按下的一个键计时，时间以10ms节拍为准，与主循环快慢无关
+ *
+ * 事件编码：EVT_KEY | 类型 | 键号
+ */
+
+// 键号(消抖状态中的位号)
+#define KEY_ID_AUTO       0   // P1.2 启动/停止定时浇水
+#define KEY_ID_TIME_UP    1   // P1.3 参数增加
+#define KEY_ID_TIME_DOWN  2   // P1.4 参数减少
+#define KEY_ID_VOL_UP     3   // P1.5
+#define KEY_ID_VOL_DOWN   4   // P1.6
+#define KEY_ID_MODE       5   // P1.7 切换参数设置项
+#define KEY_ID_SET        6   // P3.3 手动浇水/设置日期时间(POWER_FAIL_INT1 时不可用)
+#define KEY_COUNT         7
+#define KEY_ID_NONE       0xFF
+
+// 事件类型
+#define KEY_EVT_PRESS     0x00    // 按下(消抖后)
+#define KEY_EVT_RELEASE   0x08    // 松开
+#define KEY_EVT_LONG      0x10    // 按住 KEY_LONG_TICKS，每次按下只发一次
+#define KEY_EVT_REPEAT    0x18    // 按住 KEY_REPEAT_DELAY 后每 KEY_REPEAT_TICKS 一次
+
+#define KEY_EVENT(kind, id)  (EVT_KEY | (kind) | (id))
+#define KEY_EVT_KIND(e)      ((e) & 0x18)
+#define KEY_EVT_ID(e)        ((e) & 0x07)
+
+// 时间(10ms节拍)
+#define KEY_LONG_TICKS    100     // 长按1秒
+#define KEY_REPEAT_DELAY  50      // 按住0.5秒后开始连发
+#define KEY_REPEAT_TICKS  15      // 连发间隔150ms
+
+// 连发加速：本次按住的连发次数超过阈值后步长 x10、x100
+#define KEY_ACCEL_10      8       // 约1.7秒后
+#define KEY_ACCEL_100     16      // 约2.9秒后
+
+extern BYTE key_state;            // 消抖后的按键状态(1=按下，位号为键号)
+
+void Key_Init(void);              // 清除消抖状态
+void Key_Tick(void);              // 采样并投递事件(仅在PCA中断中调用)
+BYTE Key_Step(BYTE evt);          // 按下/连发事件对应的步长 1/10/100(主循环中调用)
+
+#endif /* __KEY_H__ */
@@ -2,6 +2,9 @@
 #include "relay.h"
 #include "flowmeter.h"
 #include "i2c.h"  
+#include "display.h"
+#include "key.h"
+#include "config.h"
 
 // 定时浇水配置 - 默认值：6:00:01开始，浇100毫升
 TimedWatering xdata timed_watering = {0, 6, 0, 1, 100, 0, 0, 0, 0};
@@ -9,22 +12,103 @@ TimedWatering xdata timed_watering = {0, 6, 0, 1, 100, 0, 0, 0, 0};
 // 手动浇水记录
 WateringRecord xdata manual_watering_record;
 
+// 手动浇水水量上限(毫升)，0表示不限，到达后由流量中断关阀
+WORD xdata manual_volume_cap = 0;
+
 // 显示模式：0=时钟，1=自动浇水参数
 BYTE auto_display_mode = DISPLAY_MODE_CLOCK;
 
 // 参数设置模式：0=开始小时，1=开始分钟，2=开始秒，3=浇水毫升数
 BYTE param_mode = PARAM_MODE_HOUR;
 
-// 显示更新标志
-bit display_update_flag = 0;
+// 浇水会话：开始浇水时把类型、开始时间和开始时的累计流量写入设置区一页，结束时清除。
+// 上电时会话仍打开，说明浇水中断电：累计流量已由掉电保存(或定期保存)写入日志区，
+// 据此补出一条记录。每次浇水换下一个槽位，4页轮转分摊写入；页都立即提交不等写回策略，
+// 写入中断电的页校验失败，视为没有会话
+//   会话页：0 SESSION_OPEN|类型 1~4 开始时间(压缩) 5~6 开始时累计流量低16位 7 校验
+//   结束页：0 SESSION_END 1~3 掉电时分秒 4 会话页校验字节 5~6 0xFF 7 校验
+//           只在掉电时写入会话的下一槽位，会话页校验字节不符的是旧结束页
+// 开始时间压缩为32位：年(减2000)6位 月4位 日5位 时5位 分6位 秒6位
+#define SESSION_OPEN    0xA0        // 会话页首字节高4位
+#define SESSION_END     0xB0        // 结束页首字节
+#define SESSION_CLOSED  0xFF        // 关闭后的会话页首字节
+
+static BYTE code session_page[SESSION_SLOTS] = {
+    SESSION_PAGE_0, SESSION_PAGE_1, SESSION_PAGE_2, SESSION_PAGE_3
+};
+static BYTE xdata session_slot = 0;     // 最近一次打开的槽位
+
+static BYTE Session_Sum(BYTE *p) {
+    BYTE i, sum = 0;
+    for(i = 0; i < EEPROM_PAGE_SIZE - 1; i++) {
+        sum += p[i];
+    }
+    return sum;
+}
+
+static void Session_Write(BYTE slot, BYTE *page) {
+    page[EEPROM_PAGE_SIZE - 1] = ~Session_Sum(page);
+    EEPROM_WriteBuf(session_page[slot], page, EEPROM_PAGE_SIZE);
+    EEPROM_CommitPage(session_page[slot]);
+}
+
+// 从影子区读出一页(不访问总线，掉电处理中可用)，校验正确且首字节高4位为 mark 时返回1
+static bit Session_Read(BYTE slot, BYTE *page, BYTE mark) {
+    EEPROM_ReadShadow(session_page[slot], page, EEPROM_PAGE_SIZE);
+    return (page[0] & 0xF0) == mark &&
+           page[EEPROM_PAGE_SIZE - 1] == (BYTE)~Session_Sum(page);
+}
+
+static void Session_Open(WateringRecord xdata *rec, unsigned long start_flow) {
+    BYTE page[EEPROM_PAGE_SIZE];
+    unsigned long t;
+    
+    t = (BYTE)(rec->start_year - 2000) & 0x3F;
+    t = (t << 4) | rec->start_month;
+    t = (t << 5) | rec->start_day;
+    t = (t << 5) | rec->start_hour;
+    t = (t << 6) | rec->start_min;
+    t = (t << 6) | rec->start_sec;
+    
+    page[0] = SESSION_OPEN | rec->type;
+    page[1] = (BYTE)t;
+    page[2] = (BYTE)(t >> 8);
+    page[3] = (BYTE)(t >> 16);
+    page[4] = (BYTE)(t >> 24);
+    page[5] = (BYTE)start_flow;
+    page[6] = (BYTE)(start_flow >> 8);
+    
+    if(++session_slot >= SESSION_SLOTS) {
+        session_slot = 0;
+    }
+    Session_Write(session_slot, page);
+}
 
-// 按键状态记录（用于消抖）
-static BYTE xdata key_prev_state = 0;
+// 改写会话页首字节即关闭会话；已关闭时内容不变，不产生写入
+static void Session_Close(void) {
+    EEPROM_Write(session_page[session_slot], SESSION_CLOSED);
+    EEPROM_CommitPage(session_page[session_slot]);
+}
 
-// 按键延时消抖
-static void KeyDelay(void) {
-    BYTE i = 30;
-    while(i--);
+// 掉电：会话打开时在下一槽位写入结束页，记下掉电时刻(一个写周期)
+void WateringSession_PowerFail(void) {
+    BYTE page[EEPROM_PAGE_SIZE];
+    BYTE slot;
+    
+    if(!Session_Read(session_slot, page, SESSION_OPEN)) {
+        return;
+    }
+    page[4] = page[EEPROM_PAGE_SIZE - 1];
+    page[0] = SESSION_END;
+    page[1] = PCA_GetHour();
+    page[2] = PCA_GetMin();
+    page[3] = PCA_GetSec();
+    page[5] = page[6] = 0xFF;
+    slot = session_slot + 1;
+    if(slot >= SESSION_SLOTS) {
+        slot = 0;
+    }
+    Session_Write(slot, page);
 }
 
 // 开始手动浇水记录 - 避免传参，直接写死类型
@@ -40,6 +124,7 @@ void StartManualWateringRecord(void) {
     
     // 记录开始时的累计流量
     manual_watering_record.total_flow = FlowMeter_GetTotalFlow();
+    Session_Open(&manual_watering_record, manual_watering_record.total_flow);
 }
 
 // 开始自动浇水记录 - 避免传参，直接写死类型
@@ -55,6 +140,7 @@ void StartAutoWateringRecord(void) {
     
     // 记录开始时的累计流量
     timed_watering.start_total_flow = FlowMeter_GetTotalFlow();
+    Session_Open(&timed_watering.current_record, timed_watering.start_total_flow);
 }
 
 // 计算手动浇水持续时间 - 内联计算，避免传参
@@ -120,6 +206,7 @@ void EndManualWateringRecord(void) {
     
     // 计算持续时间
     CalculateManualDuration();
+    Session_Close();
     
     // 发送浇水记录到串口
     UART_SendManualWateringRecord();
@@ -144,122 +231,206 @@ void EndAutoWateringRecord(void) {
     
     // 计算持续时间
     CalculateAutoDuration();
+    Session_Close();
     
     // 发送浇水记录到串口
     UART_SendAutoWateringRecord();
 }
 
+// 上电：会话仍打开时补出一条带 WATERING_TYPE_POWER_FAIL 标志的记录并关闭会话。
+// 浇水量为日志区恢复的累计流量与开始时累计流量低16位之差，差值超过32767毫升
+// 视为日志区落后于开始时刻(断电前未来得及保存)记为0；结束时间为掉电时刻，
+// 未记下时等于开始时间。软件时钟上电后重新计时，不续浇剩余水量。
+// 没有打开的会话时按日志区写入次数选一个起始槽位，避免每次上电都从同一页开始
+bit WateringSession_Restore(void) {
+    BYTE head[EEPROM_PAGE_SIZE], tail[EEPROM_PAGE_SIZE];
+    WateringRecord xdata *rec;
+    unsigned long t, current_total_flow;
+    WORD start_flow, volume;
+    BYTE slot;
+    bit auto_type;
+    
+    for(slot = 0; slot < SESSION_SLOTS; slot++) {
+        if(Session_Read(slot, head, SESSION_OPEN)) {
+            break;
+        }
+    }
+    if(slot >= SESSION_SLOTS) {
+        session_slot = (BYTE)(AT24C02_GetFlowWrites() % SESSION_SLOTS);
+        return 0;
+    }
+    session_slot = slot;
+    auto_type = (head[0] & WATERING_TYPE_MASK) == WATERING_TYPE_AUTO;
+    rec = auto_type ? &timed_watering.current_record : &manual_watering_record;
+    
+    t = head[1] | ((unsigned long)head[2] << 8) |
+        ((unsigned long)head[3] << 16) | ((unsigned long)head[4] << 24);
+    rec->type = (head[0] & WATERING_TYPE_MASK) | WATERING_TYPE_POWER_FAIL;
+    rec->start_sec = (BYTE)t & 0x3F;
+    rec->start_min = (BYTE)(t >> 6) & 0x3F;
+    rec->start_hour = (BYTE)(t >> 12) & 0x1F;
+    rec->start_day = (BYTE)(t >> 17) & 0x1F;
+    rec->start_month = (BYTE)(t >> 22) & 0x0F;
+    rec->start_year = 2000 + (BYTE)(t >> 26);
+    
+    rec->end_year = rec->start_year;
+    rec->end_month = rec->start_month;
+    rec->end_day = rec->start_day;
+    if(++slot >= SESSION_SLOTS) {
+        slot = 0;
+    }
+    if(!Session_Read(slot, tail, SESSION_END) || tail[4] != head[EEPROM_PAGE_SIZE - 1]) {
+        rec->end_hour = rec->start_hour;
+        rec->end_min = rec->start_min;
+        rec->end_sec = rec->start_sec;
+    } else {
+        rec->end_hour = tail[1];
+        rec->end_min = tail[2];
+        rec->end_sec = tail[3];
+        // 掉电时刻早于开始时刻：跨过午夜
+        if(tail[1] < rec->start_hour || (tail[1] == rec->start_hour &&
+           (tail[2] < rec->start_min || (tail[2] == rec->start_min && tail[3] < rec->start_sec)))) {
+            if(++rec->end_day > PCA_GetDaysInMonth(rec->end_year, rec->end_month)) {
+                rec->end_day = 1;
+                if(++rec->end_month > 12) {
+                    rec->end_month = 1;
+                    rec->end_year++;
+                }
+            }
+        }
+    }
+    
+    start_flow = head[5] | ((WORD)head[6] << 8);
+    current_total_flow = FlowMeter_GetTotalFlow();
+    volume = (WORD)current_total_flow - start_flow;
+    if(volume & 0x8000) {
+        volume = 0;
+    }
+    rec->water_volume = volume;
+    rec->total_flow = current_total_flow;
+    
+    Session_Close();
+    if(auto_type) {
+        timed_watering.start_total_flow = current_total_flow - volume;
+        CalculateAutoDuration();
+        UART_SendAutoWateringRecord();
+    } else {
+        CalculateManualDuration();
+        UART_SendManualWateringRecord();
+    }
+    return 1;
+}
+
 // 初始化按键控制
+// 日程等保存的参数由 Config_Load 恢复，这里只清运行状态
 void KeyboardControl_Init(void) {
-    // 设置按键引脚为输入（上拉）
-    P1 |= 0xFC;  // P1.2-P1.7设为高电平（输入模式）
-    
-    // 初始化I2C和24C02
-    I2C_Init();
-    
-    // 初始化定时浇水参数为默认值
-    timed_watering.enabled = 0;
-    timed_watering.start_hour = 6;      // 默认6点
-    timed_watering.start_min = 0;       // 0分
-    timed_watering.start_sec = 1;       // 1秒开始浇水
-    timed_watering.water_volume_ml = 100; // 浇水100毫升
     timed_watering.is_watering = 0;
     timed_watering.watering_volume_left = 0;
     timed_watering.triggered_today = 0;
     timed_watering.start_total_flow = 0;
     
-    auto_display_mode = DISPLAY_MODE_CLOCK;
+    KeyboardControl_SetDisplayMode(DISPLAY_MODE_CLOCK);
     param_mode = PARAM_MODE_HOUR;
 }
 
-// 按键扫描
-void KeyboardControl_Scan(void) {
-    BYTE current_keys = 0;
-    BYTE key_pressed;
-    
-    // 读取当前按键状态
-    if(KEY_AUTO == 0) current_keys |= 0x01;
-    if(KEY_TIME_UP == 0) current_keys |= 0x02;
-    if(KEY_TIME_DOWN == 0) current_keys |= 0x04;
-    if(KEY_VOL_UP == 0) current_keys |= 0x08;
-    if(KEY_VOL_DOWN == 0) current_keys |= 0x10;
-    if(KEY_MODE == 0) current_keys |= 0x20;
-    
-    // 检测按键按下（下降沿）
-    key_pressed = (~key_prev_state) & current_keys;
-    
-    if(key_pressed & 0x01) {  // KEY_AUTO按下
-        KeyDelay();
-        if(KEY_AUTO == 0) {
-            if(timed_watering.enabled) {
-                TimedWatering_Stop();
-                auto_display_mode = DISPLAY_MODE_CLOCK;
-                FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
-                display_update_flag = 1;
-            } else {
-                TimedWatering_Start();
-            }
-        }
+// 切换时钟/参数显示：参数视图请求显示或撤销，内容标记为需重画
+void KeyboardControl_SetDisplayMode(BYTE mode) {
+    auto_display_mode = mode;
+    if(mode == DISPLAY_MODE_AUTO) {
+        DISPLAY_SHOW(DISP_VIEW_PARAM);
+    } else {
+        DISPLAY_HIDE(DISP_VIEW_PARAM);
     }
+    DISPLAY_INVALIDATE(DISP_VIEW_PARAM);
+}
+
+// 浇水毫升数按 50*step 增减，限制在 50~9950
+static void VolumeStep(BYTE step, bit down) {
+    WORD delta = (WORD)step * 50;
     
-    if(key_pressed & 0x20) {  // KEY_MODE按下
-        KeyDelay();
-        if(KEY_MODE == 0) {
-            param_mode = (param_mode + 1) % 4;  // 4个参数模式
-            auto_display_mode = DISPLAY_MODE_AUTO;
-            display_update_flag = 1;
-        }
+    if(down) {
+        timed_watering.water_volume_ml = (timed_watering.water_volume_ml > 50 + delta) ?
+                                         (timed_watering.water_volume_ml - delta) : 50;
+    } else {
+        timed_watering.water_volume_ml = (timed_watering.water_volume_ml + delta < 9950) ?
+                                         (timed_watering.water_volume_ml + delta) : 9950;
     }
+}
+
+// 当前参数按步长增减：时分秒回绕(步长最大10)，毫升数见 VolumeStep
+static void ParamStep(BYTE step, bit down) {
+    if(param_mode != PARAM_MODE_VOLUME && step > 10) {
+        step = 10;
+    }
+    switch(param_mode) {
+        case PARAM_MODE_HOUR:
+            timed_watering.start_hour = down ? (timed_watering.start_hour + 24 - step) % 24 :
+                                               (timed_watering.start_hour + step) % 24;
+            break;
+        case PARAM_MODE_MIN:
+            timed_watering.start_min = down ? (timed_watering.start_min + 60 - step) % 60 :
+                                              (timed_watering.start_min + step) % 60;
+            break;
+        case PARAM_MODE_SEC:
+            timed_watering.start_sec = down ? (timed_watering.start_sec + 60 - step) % 60 :
+                                              (timed_watering.start_sec + step) % 60;
+            break;
+        case PARAM_MODE_VOLUME:
+            VolumeStep(step, down);
+            break;
+    }
+    Config_Save();
+    KeyboardControl_SetDisplayMode(DISPLAY_MODE_AUTO);
+}
+
+// P1 按键事件(已消抖)：按下时动作；增减键按住时连发，步长随按住时间 1->10->100 加速
+void KeyboardControl_OnKey(BYTE evt) {
+    BYTE kind = KEY_EVT_KIND(evt);
     
-    if(key_pressed & 0x02) {  // KEY_TIME_UP按下
-        KeyDelay();
-        if(KEY_TIME_UP == 0) {
-            switch(param_mode) {
-                case PARAM_MODE_HOUR:
-                    timed_watering.start_hour = (timed_watering.start_hour + 1) % 24;
-                    break;
-                case PARAM_MODE_MIN:
-                    timed_watering.start_min = (timed_watering.start_min + 1) % 60;
-                    break;
-                case PARAM_MODE_SEC:
-                    timed_watering.start_sec = (timed_watering.start_sec + 1) % 60;
-                    break;
-                case PARAM_MODE_VOLUME:
-                    if(timed_watering.water_volume_ml < 9950) {
-                        timed_watering.water_volume_ml += 50;
-                    }
-                    break;
-            }
-            auto_display_mode = DISPLAY_MODE_AUTO;
-            display_update_flag = 1;
-        }
+    if(kind != KEY_EVT_PRESS && kind != KEY_EVT_REPEAT) {
+        return;
     }
     
-    if(key_pressed & 0x04) {  // KEY_TIME_DOWN按下
-        KeyDelay();
-        if(KEY_TIME_DOWN == 0) {
-            switch(param_mode) {
-                case PARAM_MODE_HOUR:
-                    timed_watering.start_hour = (timed_watering.start_hour == 0) ? 23 : (timed_watering.start_hour - 1);
-                    break;
-                case PARAM_MODE_MIN:
-                    timed_watering.start_min = (timed_watering.start_min == 0) ? 59 : (timed_watering.start_min - 1);
-                    break;
-                case PARAM_MODE_SEC:
-                    timed_watering.start_sec = (timed_watering.start_sec == 0) ? 59 : (timed_watering.start_sec - 1);
-                    break;
-                case PARAM_MODE_VOLUME:
-                    if(timed_watering.water_volume_ml > 50) {
-                        timed_watering.water_volume_ml -= 50;
-                    }
-                    break;
+    switch(KEY_EVT_ID(evt)) {
+        case KEY_ID_AUTO:
+            if(kind != KEY_EVT_PRESS) {
+                break;
             }
-            auto_display_mode = DISPLAY_MODE_AUTO;
-            display_update_flag = 1;
-        }
+            if(timed_watering.enabled) {
+                TimedWatering_Stop();
+                KeyboardControl_SetDisplayMode(DISPLAY_MODE_CLOCK);
+            } else {
+                TimedWatering_Start();
+            }
+            break;
+            
+        case KEY_ID_MODE:
+            if(kind != KEY_EVT_PRESS) {
+                break;
+            }
+            param_mode = (param_mode + 1) % 4;  // 4个参数模式
+            KeyboardControl_SetDisplayMode(DISPLAY_MODE_AUTO);
+            break;
+            
+        case KEY_ID_TIME_UP:
+            ParamStep(Key_Step(evt), 0);
+            break;
+            
+        case KEY_ID_TIME_DOWN:
+            ParamStep(Key_Step(evt), 1);
+            break;
+            
+        // 毫升数专用增减键：直接切到毫升设置项
+        case KEY_ID_VOL_UP:
+            param_mode = PARAM_MODE_VOLUME;
+            ParamStep(Key_Step(evt), 0);
+            break;
+            
+        case KEY_ID_VOL_DOWN:
+            param_mode = PARAM_MODE_VOLUME;
+            ParamStep(Key_Step(evt), 1);
+            break;
     }
-    
-    key_prev_state = current_keys;
 }
 
 // 启动定时浇水
@@ -267,19 +438,17 @@ void TimedWatering_Start(void) {
     timed_watering.enabled = 1;
     timed_watering.is_watering = 0;
     timed_watering.triggered_today = 0;  // 重置触发标志
+    Config_Save();
     
     // 启动后立即返回时钟显示模式，而不是显示参数
-    auto_display_mode = DISPLAY_MODE_CLOCK;
-    display_update_flag = 1;  // 设置标志立即更新显示
-    
-    // 强制更新时钟显示
-    FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
+    KeyboardControl_SetDisplayMode(DISPLAY_MODE_CLOCK);
 }
 
 // 停止定时浇水
 void TimedWatering_Stop(void) {
     timed_watering.enabled = 0;
     timed_watering.triggered_today = 0;
+    Config_Save();
     
     // 如果正在浇水，立即停止并记录
     if(timed_watering.is_watering) {
@@ -293,6 +462,32 @@ void TimedWatering_Stop(void) {
     }
 }
 
+// 自动浇水结束：阀门已由流量中断或每秒检查关闭，这里完成记录和显示
+static void TimedWatering_Finish(void) {
+    timed_watering.is_watering = 0;
+    timed_watering.triggered_today = 1;  // 标记今天已触发
+    
+    Relay_Off();
+    FlowMeter_Stop();
+    FlowMeter_SetMode(FLOW_MODE_OFF);
+    
+    // 保存累计流量到24C02(同时清除流量计的待保存标记)
+    SaveTotalFlowToEEPROM();
+    
+    // 记录自动浇水结束
+    EndAutoWateringRecord();
+    
+    // 浇水完成后返回时钟显示
+    KeyboardControl_SetDisplayMode(DISPLAY_MODE_CLOCK);
+}
+
+// 处理 EVT_VOLUME_DONE：自动浇水达到目标水量
+void TimedWatering_OnVolumeDone(void) {
+    if(timed_watering.is_watering) {
+        TimedWatering_Finish();
+    }
+}
+
 // 更新定时浇水状态（每秒调用一次）
 void TimedWatering_Update(void) {
     unsigned long current_total_flow;
@@ -306,31 +501,15 @@ void TimedWatering_Update(void) {
         watered_volume = current_total_flow - timed_watering.start_total_flow;
         
         if(watered_volume >= timed_watering.water_volume_ml) {
-            // 达到目标毫升数，停止浇水
-            timed_watering.is_watering = 0;
-            timed_watering.triggered_today = 1;  // 标记今天已触发
-            
-            Relay_Off();
-            FlowMeter_Stop();
-            FlowMeter_SetMode(FLOW_MODE_OFF);
-            
-            // 保存累计流量到24C02
-            AT24C02_WriteTotalFlow(current_total_flow);
-            
-            // 记录自动浇水结束
-            EndAutoWateringRecord();
-            
-            // 浇水完成后返回时钟显示
-            auto_display_mode = DISPLAY_MODE_CLOCK;
-            FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
-            display_update_flag = 1;
+            // 正常由流量中断在目标脉冲上关阀，这里只是兜底
+            TimedWatering_Finish();
         } else {
             // 更新剩余毫升数显示
             timed_watering.watering_volume_left = timed_watering.water_volume_ml - watered_volume;
             if(auto_display_mode != DISPLAY_MODE_AUTO) {
-                auto_display_mode = DISPLAY_MODE_AUTO;
-                display_update_flag = 1;
+                KeyboardControl_SetDisplayMode(DISPLAY_MODE_AUTO);
             }
+            DISPLAY_INVALIDATE(DISP_VIEW_PARAM);
         }
     } else {
         // 每天检查是否到达设定时间点
@@ -347,12 +526,13 @@ void TimedWatering_Update(void) {
             // 记录自动浇水开始
             StartAutoWateringRecord();
             
-            Relay_On();
+            // 先设置目标再开阀，第一个脉冲起就开始倒计数
             FlowMeter_Start();
+            FlowMeter_SetTarget(timed_watering.water_volume_ml);
+            Relay_On();
             FlowMeter_SetMode(FLOW_MODE_CURR);
             
-            auto_display_mode = DISPLAY_MODE_AUTO;
-            display_update_flag = 1;
+            KeyboardControl_SetDisplayMode(DISPLAY_MODE_AUTO);
         }
         
         // 午夜重置，确保每天都能触发
@@ -363,7 +543,7 @@ void TimedWatering_Update(void) {
     }
 }
 
-// 显示自动浇水参数
+// 显示自动浇水参数(参数视图，由 Display_Render 在视图变脏时调用)
 void DisplayAutoWateringParams(void) {
     BYTE val1, val2, val3, val4, val5, val6, val7, val8;
     
@@ -429,14 +609,3 @@ void DisplayAutoWateringParams(void) {
     // 使用8位显示缓冲区
     FillCustomDispBuf8(val1, val2, val3, val4, val5, val6, val7, val8);
 }
-
-// 检查并更新自动显示
-void CheckAndUpdateAutoDisplay(void) {
-    if(display_update_flag) {
-        display_update_flag = 0;  // 清除标志
-        
-        if(auto_display_mode == DISPLAY_MODE_AUTO) {
-            DisplayAutoWateringParams();
-        }
-    }
-}
@@ -5,13 +5,8 @@
 #include "pca.h"
 #include "uart.h" 
 
-// 按键定义
-sbit KEY_AUTO = P1^2;         // 启动/停止定时浇水
-sbit KEY_TIME_UP = P1^3;      // 增加浇水时间
-sbit KEY_TIME_DOWN = P1^4;    // 减少浇水时间
-sbit KEY_VOL_UP = P1^5;       // 增加浇水毫升数
-sbit KEY_VOL_DOWN = P1^6;     // 减少浇水毫升数
-sbit KEY_MODE = P1^7;         // 切换参数设置模式
+// 按键：P1.2 启停定时浇水、P1.3/P1.4 参数增减、P1.5/P1.6 毫升数增减、P1.7 切换参数设置项
+// 由 key.c 在PCA节拍中整口采样消抖，这里只处理事件
 
 // 定时浇水配置结构
 typedef struct TimedWatering {
@@ -42,19 +37,24 @@ typedef struct TimedWatering {
 extern TimedWatering xdata timed_watering; 
 extern unsigned char auto_display_mode;
 extern unsigned char param_mode;
-extern bit display_update_flag; 
 
 // 手动浇水记录变量
 extern WateringRecord xdata manual_watering_record;
+extern WORD xdata manual_volume_cap;      // 手动浇水水量上限(0=不限)
 
 // 函数声明
 void KeyboardControl_Init(void);
-void KeyboardControl_Scan(void);
+void KeyboardControl_OnKey(BYTE evt);     // 处理 P1 按键事件(EVT_KEY)
 void TimedWatering_Update(void);
 void TimedWatering_Start(void);
 void TimedWatering_Stop(void);
+void TimedWatering_OnVolumeDone(void);    // 处理 EVT_VOLUME_DONE
+void KeyboardControl_SetDisplayMode(BYTE mode);  // 切换时钟/参数显示(DISPLAY_MODE_xxx)
 void DisplayAutoWateringParams(void);
-void CheckAndUpdateAutoDisplay(void);
+
+// 浇水会话：浇水中掉电时上电补出记录
+void WateringSession_PowerFail(void);     // 掉电：记下掉电时刻(Power_Fail 调用)
+bit WateringSession_Restore(void);        // 上电：补出掉电中断的浇水记录，有则返回1
 
 // 浇水记录相关函数 - 避免传参
 void StartManualWateringRecord(void);     // 开始手动浇水记录
@@ -7,6 +7,12 @@
 #include "uart.h"      // 添加串口通信头文件
 #include "keyboard_control.h"  // 添加按键控制头文件
 #include "i2c.h"      // 添加I2C头文件
+#include "event.h"    // 中断事件队列
+#include "display.h"  // 显示合成
+#include "key.h"      // 按键消抖事件
+#include "power.h"    // 空闲与睡眠
+#include "sched.h"    // 协作式调度
+#include "config.h"   // 配置块
 
 #define multiplier 1.085
 
@@ -23,93 +29,55 @@
 // 当前系统状态
 BYTE sysState = SYS_STATE_OFF;
 
-// 按键和浇水控制相关变量
-sbit KEY = P3^3;            // 按键连接到P3.3
-bit keyPressed = 0;         // 按键按下标志
-bit justEnteredSetMode = 0; // 标志是否刚刚进入设置模式
-unsigned int xdata keyPressTime = 0; // 按键按下持续时间（以10ms为单位）
-#define LONG_PRESS_TIME 100   // 长按时间阈值
+// P3.3 本次按下是否已触发长按(松开时不再当作短按)
+static bit keyLongDone = 0;
 
-// 按键处理函数
-void processKey() {
-    if (KEY == 0 && !keyPressed) {
-        keyPressed = 1;
-        keyPressTime = 0;
-    } 
-    else if (KEY == 0 && keyPressed) {
-        keyPressTime++;
-        
-        // 长按进入设置模式，从年份开始设置
-        if (keyPressTime == LONG_PRESS_TIME && sysState == SYS_STATE_OFF) {
-            sysState = SYS_STATE_SET_YEAR;
-            PCA_SetTimeEditMode(YEAR_POS);
-            PCA_SetDisplayMode(DISPLAY_DATE_MODE);  // 切换到日期显示模式
-            PCA_ResetAutoToggle();  // 重置自动轮换计数器
-            justEnteredSetMode = 1;
-        }
-    }
-    else if (KEY == 1 && keyPressed) {
-        if (keyPressTime < LONG_PRESS_TIME) {
-            // 短按：根据当前状态增加对应的数值
-            switch (sysState) {
-                case SYS_STATE_OFF:
-                    // 检查是否定时浇水正在运行
-                    if(!timed_watering.enabled || !timed_watering.is_watering) {
-                        sysState = SYS_STATE_WATERING;
-                        
-                        // 开始手动浇水记录
-                        StartManualWateringRecord();
-                        
-                        Relay_On();
-                        FlowMeter_Reset();
-                        FlowMeter_Start();
-                        FlowMeter_SetMode(FLOW_MODE_CURR);
-                        FlowMeter_UpdateDisplay();
-                        auto_display_mode = DISPLAY_MODE_CLOCK; // 手动浇水时显示时钟
-                    }
-                    break;
-                    
-                case SYS_STATE_WATERING:
-                    sysState = SYS_STATE_OFF;
-                    Relay_Off();
-                    FlowMeter_Stop();
-                    FlowMeter_SetMode(FLOW_MODE_OFF);
-                    
-                    // 结束手动浇水记录
-                    EndManualWateringRecord();
-                    break;
-                    
-                case SYS_STATE_SET_YEAR:
-                    PCA_IncreaseTimeValue(YEAR_POS);
-                    break;
-                    
-                case SYS_STATE_SET_MONTH:
-                    PCA_IncreaseTimeValue(MONTH_POS);
-                    break;
-                    
-                case SYS_STATE_SET_DAY:
-                    PCA_IncreaseTimeValue(DAY_POS);
-                    break;
-                    
-                case SYS_STATE_SET_HOUR:
-                    PCA_IncreaseTimeValue(HOUR_POS);
-                    break;
-                    
-                case SYS_STATE_SET_MIN:
-                    PCA_IncreaseTimeValue(MIN_POS);
-                    break;
-                    
-                case SYS_STATE_SET_SEC:
-                    PCA_IncreaseTimeValue(SEC_POS);
-                    break;
-            }
-        } 
-        else if (keyPressTime >= LONG_PRESS_TIME) {
-            // 长按：切换到下一项设置
-            if (justEnteredSetMode) {
-                justEnteredSetMode = 0;
+// 开始手动浇水：先设置水量上限再开阀
+static void StartManualWatering(void) {
+    sysState = SYS_STATE_WATERING;
+    
+    // 开始手动浇水记录
+    StartManualWateringRecord();
+    
+    FlowMeter_Reset();
+    FlowMeter_Start();
+    FlowMeter_SetTarget(manual_volume_cap);
+    Relay_On();
+    FlowMeter_SetMode(FLOW_MODE_CURR);
+    KeyboardControl_SetDisplayMode(DISPLAY_MODE_CLOCK); // 手动浇水结束后回到时钟
+}
+
+// 结束手动浇水：按键再次按下，或达到水量上限(阀门已由中断关闭)
+static void StopManualWatering(void) {
+    sysState = SYS_STATE_OFF;
+    Relay_Off();
+    FlowMeter_Stop();
+    FlowMeter_SetMode(FLOW_MODE_OFF);
+    
+    // 结束手动浇水记录
+    EndManualWateringRecord();
+}
+
+// P3.3 按键事件处理：
+// 短按(松开时)根据当前状态启停手动浇水或增加设置项；
+// 长按(按住1秒时)进入设置模式，设置模式中切换到下一项
+void processKey(BYTE evt) {
+    switch (KEY_EVT_KIND(evt)) {
+        case KEY_EVT_PRESS:
+            keyLongDone = 0;
+            break;
+            
+        case KEY_EVT_LONG:
+            keyLongDone = 1;
+            if (sysState == SYS_STATE_OFF) {
+                // 长按进入设置模式，从年份开始设置
+                sysState = SYS_STATE_SET_YEAR;
+                PCA_SetTimeEditMode(YEAR_POS);
+                PCA_SetDisplayMode(DISPLAY_DATE_MODE);  // 切换到日期显示模式
+                PCA_ResetAutoToggle();  // 重置自动轮换计数器
             }
             else if (sysState >= SYS_STATE_SET_YEAR && sysState <= SYS_STATE_SET_SEC) {
+                // 长按：切换到下一项设置
                 sysState++;
                 
                 // 设置完所有参数后退出设置模式
@@ -149,50 +117,211 @@ void processKey() {
                     }
                 }
             }
+            break;
+            
+        case KEY_EVT_RELEASE:
+            if (keyLongDone) {
+                break;
+            }
+            // 短按：根据当前状态增加对应的数值
+            switch (sysState) {
+                case SYS_STATE_OFF:
+                    // 检查是否定时浇水正在运行
+                    if(!timed_watering.enabled || !timed_watering.is_watering) {
+                        StartManualWatering();
+                    }
+                    break;
+                    
+                case SYS_STATE_WATERING:
+                    StopManualWatering();
+                    break;
+                    
+                case SYS_STATE_SET_YEAR:
+                    PCA_IncreaseTimeValue(YEAR_POS);
+                    break;
+                    
+                case SYS_STATE_SET_MONTH:
+                    PCA_IncreaseTimeValue(MONTH_POS);
+                    break;
+                    
+                case SYS_STATE_SET_DAY:
+                    PCA_IncreaseTimeValue(DAY_POS);
+                    break;
+                    
+                case SYS_STATE_SET_HOUR:
+                    PCA_IncreaseTimeValue(HOUR_POS);
+                    break;
+                    
+                case SYS_STATE_SET_MIN:
+                    PCA_IncreaseTimeValue(MIN_POS);
+                    break;
+                    
+                case SYS_STATE_SET_SEC:
+                    PCA_IncreaseTimeValue(SEC_POS);
+                    break;
+            }
+            break;
+    }
+}
+
+// 设置模式中 P1.3/P1.4 增减正在编辑的项，按住连发加速(最大步长10)
+// 返回0表示不在设置模式或不是增减键，事件交给按键控制模块
+static bit processEditKey(BYTE evt) {
+    BYTE id = KEY_EVT_ID(evt);
+    BYTE kind = KEY_EVT_KIND(evt);
+    BYTE step;
+    
+    if (sysState < SYS_STATE_SET_YEAR || sysState > SYS_STATE_SET_SEC ||
+        (id != KEY_ID_TIME_UP && id != KEY_ID_TIME_DOWN)) {
+        return 0;
+    }
+    if (kind == KEY_EVT_PRESS || kind == KEY_EVT_REPEAT) {
+        step = Key_Step(evt);
+        if (step > 10) {
+            step = 10;
         }
-        
-        keyPressed = 0;
-        keyPressTime = 0;
-        delay_ms(20);
+        PCA_StepTimeValue(sysState - SYS_STATE_SET_YEAR + YEAR_POS, step, id == KEY_ID_TIME_DOWN);
+    }
+    return 1;
+}
+
+// 处理中断送来的事件：按键和达量关阀直接处理，其余交给对应的任务
+static void DispatchEvents(void) {
+    BYTE evt;
+    
+    while ((evt = Event_Get()) != EVT_NONE) {
+        switch (evt) {
+            case EVT_SECOND:
+                Sched_Trigger(TASK_SECOND);
+                break;
+                
+            case EVT_HALF_SECOND:
+                Sched_Trigger(TASK_BLINK);
+                break;
+                
+            case EVT_UART_LINE:
+                Sched_Trigger(TASK_UART_CMD);
+                break;
+                
+            case EVT_VOLUME_DONE:
+                // 阀门已在中断中关闭，这里补完记录
+                if (timed_watering.is_watering) {
+                    TimedWatering_OnVolumeDone();
+                } else if (sysState == SYS_STATE_WATERING) {
+                    StopManualWatering();
+                }
+                break;
+                
+            default:
+                // 按键事件：P3.3 由本文件处理，P1 上的键交给按键控制模块
+                if (evt & EVT_KEY) {
+                    Power_Wake();
+                    if (KEY_EVT_ID(evt) == KEY_ID_SET) {
+                        processKey(evt);
+                    } else if (!processEditKey(evt)) {
+                        KeyboardControl_OnKey(evt);
+                    }
+                }
+                break;
+        }
+    }
+}
+
+// 任务表(sched.h)中各任务的执行体
+static void RunTask(BYTE task) {
+    switch (task) {
+        case TASK_EVENTS:
+            DispatchEvents();
+            break;
+            
+        case TASK_SECOND:
+            PCA_ProcessTimeUpdate();
+            PCA_ProcessDisplayUpdate();
+            Power_Second();
+            EEPROM_Second();    // 影子区按策略写回
+            break;
+            
+        case TASK_BLINK:
+            PCA_ProcessBlinkUpdate();
+            break;
+            
+        case TASK_UART_CMD:
+            Power_Wake();
+            UART_ProcessCommand();
+            break;
+            
+        case TASK_FLOW:
+            FlowMeter_UpdateRate();
+            break;
+            
+        case TASK_EEPROM:
+            EEPROM_Poll();      // 推进EEPROM异步写入
+            break;
+            
+        case TASK_UART_TX:
+            UART_Poll();        // 逐行输出记录和长回复
+            break;
+            
+        case TASK_DISPLAY:
+            Display_Render();       // 只画最高优先级的视图，且仅在它变脏时
+            PCA_DisplayCommit();    // 本轮显示内容交给扫描中断
+            break;
     }
 }
 
 void main(void) {
+    BYTE task;
+    
     EA = 1;
     P0 = 0xFF;
     
     
     
+    Event_Init();
+    Display_Init();
+    Key_Init();
+    Power_Init();
     PCA_Init();
     Relay_Init();
+#if FLOW_BACKEND == FLOW_BACKEND_INT0
     WaveGen_Init();
-    WaveGen_Start();
+    WaveGen_Start();    // P1.0方波模拟流量脉冲(T2计数方式下P1.0为传感器输入)
+#endif
     UART_Init();
     I2C_Init();  
     FlowMeter_Init();
     KeyboardControl_Init();  // 初始化按键控制
+    if (Config_Load()) {     // 配置块无效时使用默认日程
+        UART_SendString("Config: Default\r\n");
+    } else {
+        UART_SendString("Config: Restored\r\n");
+    }
+    WateringSession_Restore();  // 浇水中掉电：补出记录(由记录输出任务逐行发送)
     
     // 发送启动信息到串口
     UART_SendString("\r\nWatering System Started v4.2 (Full 8-Digit Display)\r\n");
     UART_SendString("Auto Display: Time<->Date every 5 seconds\r\n");
     UART_SendString("Date Format: YYYYMMDD (8-digit full display)\r\n");
     UART_SendString("Time Format: HH-MM-SS (8-digit full display)\r\n");
-    UART_SendString("Flow Format: XXXXXXX10/11 (8-digit, 7-digit flow value)\r\n");
+    UART_SendString("Flow Format: XXXXXX.X10/XXXXXXX11 (ml/s with 0.1 digit / total ml)\r\n");
     UART_SendString("Auto Format: XXXXXXXA/B/c/d (8-digit param display)\r\n");
     UART_SendString("P3.3 Key: Long press to set date/time\r\n");
     UART_SendString("Setting order: Year->Month->Day->Hour->Min->Sec\r\n");
     
+    Sched_Init();
+    
+    // 每次执行一个优先级最高的就绪任务，没有就绪任务时空闲等中断
     while (1) {
-        processKey();
-        KeyboardControl_Scan();
-        CheckAndUpdateAutoDisplay();
-        FlowMeter_UpdateDisplay();
-        UART_ProcessCommand();
-        
-        PCA_ProcessTimeUpdate();
-        PCA_ProcessDisplayUpdate();
-        PCA_ProcessBlinkUpdate();
-
-        delay_ms(10);
+        POWER_FAIL_CHECK();     // 掉电保存优先于任何任务
+        task = Sched_Next();
+        if (task == TASK_NONE) {
+            Power_Idle();
+            if (EEPROM_IsBusy()) {
+                Sched_Trigger(TASK_EEPROM); // 写周期中每次唤醒(约1ms)查询一次应答
+            }
+            continue;
+        }
+        RunTask(task);
+        Sched_Done(task);
     }
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "pca.h"     
 #include "flowmeter.h" 
 #include "keyboard_control.h" 
+#include "event.h"
+#include "display.h"
+#include "key.h"
 
 #define FOSC    11059200L
 #define T100Hz  (FOSC / 12 / 100)
@@ -15,8 +18,6 @@ sbit CCF1       =   CCON^1;         //PCA module-1 interrupt flag
 sbit CR         =   CCON^6;         //PCA timer run control bit
 sbit CF         =   CCON^7;         //PCA timer overflow flag
 sfr CMOD        =   0xD9;           //PCA mode register
-sfr CL          =   0xE9;           //PCA base timer LOW
-sfr CH          =   0xF9;           //PCA base timer HIGH
 sfr CCAPM0      =   0xDA;           //PCA module-0 mode register
 sfr CCAP0L      =   0xEA;           //PCA module-0 capture register LOW
 sfr CCAP0H      =   0xFA;           //PCA module-0 capture register HIGH
@@ -26,16 +27,16 @@ sfr CCAP1H      =   0xFB;           //PCA module-1 capture register HIGH
 sfr PCAPWM0     =   0xf2;
 sfr PCAPWM1     =   0xf3;
 
-sbit PCA_LED    =   P1^0;           //PCA test LED
+#if FLOW_BACKEND != FLOW_BACKEND_T2
+sbit PCA_LED    =   P1^0;           //PCA test LED(T2计数方式下P1.0为传感器输入，不再闪烁)
+#endif
 
 BYTE cnt;
+BYTE pca_tick;                      // 10ms节拍，自由运行(溢出回绕)
 WORD xdata value;
 WORD xdata value1;
 
-static bit time_update_flag = 0;
-static bit display_update_needed = 0;
-static bit watering_check_needed = 0;
-static bit blink_update_needed = 0;
+static BYTE pending_seconds = 0;    // 中断已计、主循环未处理的秒数
 
 // 初始化为2025年1月1日 00:00:00
 SYS_PARAMS SysPara1 = {2025, 1, 1, 0, 0, 0};
@@ -74,6 +75,13 @@ unsigned char xdata dispbuff[8] = {SEG_OFF,SEG_OFF,SEG_OFF,SEG_OFF,SEG_OFF,SEG_O
 
 // 日期时间显示模式
 BYTE datetime_display_mode = DISPLAY_TIME_MODE;  // 默认显示时间
+BYTE datetime_display_pref = DISPLAY_TIME_MODE;  // DISPTIME/DISPDATE 选择的模式，保存在配置块
+
+// 增量刷新：dispbuff 的版面及各字段已显示的值(0xFF表示需要重画)
+BYTE disp_layout = DISP_LAYOUT_NONE;
+static BYTE xdata shownSec, shownMin, shownHour;
+static BYTE xdata shownDay, shownMonth;
+static WORD xdata shownYear;
 
 // 实现显示相关函数
 void delay_ms(unsigned int ms) {
@@ -85,52 +93,122 @@ void delay_ms(unsigned int ms) {
 void Resetdispbuff() {
     unsigned char i;
     for(i = 0; i < 8; i++) dispbuff[i] = SEG_OFF;
+    disp_layout = DISP_LAYOUT_NONE;
 }
 
+// 填充时间显示缓冲区 (HH-MM-SS)
+// 已是时间版面时只改写变化的字段，每秒通常只写秒的两位
 void FillDispBuf(BYTE hour, BYTE min, BYTE sec) {
-    Resetdispbuff();
+    if(disp_layout != DISP_LAYOUT_TIME) {
+        // 横线（右起第2、5位）
+        dispbuff[2] = 0x40;
+        dispbuff[5] = 0x40;
+        shownSec = shownMin = shownHour = 0xFF;
+        disp_layout = DISP_LAYOUT_TIME;
+    }
     
     // 秒部分（右起0-1位）
-    dispbuff[0] = LED[sec % 10];   // 秒个位
-    dispbuff[1] = LED[sec / 10];   // 秒十位
-    
-    // 第一个横线（右起第2位）
-    dispbuff[2] = 0x40;  // 显示横线 "-"
+    if(sec != shownSec) {
+        dispbuff[0] = LED[sec % 10];   // 秒个位
+        dispbuff[1] = LED[sec / 10];   // 秒十位
+        shownSec = sec;
+    }
     
     // 分钟部分（右起3-4位）
-    dispbuff[3] = LED[min % 10];   // 分个位
-    dispbuff[4] = LED[min / 10];   // 分十位
-    
-    // 第二个横线（右起第5位）
-    dispbuff[5] = 0x40;  // 显示横线 "-"
+    if(min != shownMin) {
+        dispbuff[3] = LED[min % 10];   // 分个位
+        dispbuff[4] = LED[min / 10];   // 分十位
+        shownMin = min;
+    }
     
     // 小时部分（右起6-7位）
-    dispbuff[6] = LED[hour % 10];  // 时个位
-    dispbuff[7] = LED[hour / 10];  // 时十位
+    if(hour != shownHour) {
+        dispbuff[6] = LED[hour % 10];  // 时个位
+        dispbuff[7] = LED[hour / 10];  // 时十位
+        shownHour = hour;
+    }
 }
 
 // 填充日期显示缓冲区 (YYYYMMDD格式，使用全部8位数码管)
+// 已是日期版面时只改写变化的字段
 void FillDateBuf(WORD year, BYTE month, BYTE day) {
-    Resetdispbuff();
+    if(disp_layout != DISP_LAYOUT_DATE) {
+        shownDay = shownMonth = 0xFF;
+        shownYear = 0xFFFF;
+        disp_layout = DISP_LAYOUT_DATE;
+    }
     
     // 日期部分（右起0-1位）
-    dispbuff[0] = LED[day % 10];   // 日个位
-    dispbuff[1] = LED[day / 10];   // 日十位
+    if(day != shownDay) {
+        dispbuff[0] = LED[day % 10];   // 日个位
+        dispbuff[1] = LED[day / 10];   // 日十位
+        shownDay = day;
+    }
     
     // 月份部分（右起2-3位）
-    dispbuff[2] = LED[month % 10]; // 月个位
-    dispbuff[3] = LED[month / 10]; // 月十位
+    if(month != shownMonth) {
+        dispbuff[2] = LED[month % 10]; // 月个位
+        dispbuff[3] = LED[month / 10]; // 月十位
+        shownMonth = month;
+    }
     
     // 年份部分（右起4-7位，显示完整4位年份）
-    dispbuff[4] = LED[year % 10];           // 年个位
-    dispbuff[5] = LED[(year / 10) % 10];    // 年十位
-    dispbuff[6] = LED[(year / 100) % 10];   // 年百位
-    dispbuff[7] = LED[(year / 1000) % 10];  // 年千位
+    if(year != shownYear) {
+        dispbuff[4] = LED[year % 10];           // 年个位
+        dispbuff[5] = LED[(year / 10) % 10];    // 年十位
+        dispbuff[6] = LED[(year / 100) % 10];   // 年百位
+        dispbuff[7] = LED[(year / 1000) % 10];  // 年千位
+        shownYear = year;
+    }
+}
+
+// 熄灭正在编辑的字段(闪烁)，并标记该字段下次需要重画
+static void BlankEditField(BYTE position) {
+    switch(position) {
+        case YEAR_POS:
+            // 年份闪烁 - 4位全部闪烁
+            dispbuff[4] = SEG_OFF;  // 年个位
+            dispbuff[5] = SEG_OFF;  // 年十位
+            dispbuff[6] = SEG_OFF;  // 年百位
+            dispbuff[7] = SEG_OFF;  // 年千位
+            shownYear = 0xFFFF;
+            break;
+        case MONTH_POS:
+            dispbuff[2] = SEG_OFF;  // 月个位
+            dispbuff[3] = SEG_OFF;  // 月十位
+            shownMonth = 0xFF;
+            break;
+        case DAY_POS:
+            dispbuff[0] = SEG_OFF;  // 日个位
+            dispbuff[1] = SEG_OFF;  // 日十位
+            shownDay = 0xFF;
+            break;
+        case HOUR_POS:
+            dispbuff[6] = SEG_OFF;  // 小时个位
+            dispbuff[7] = SEG_OFF;  // 小时十位
+            shownHour = 0xFF;
+            break;
+        case MIN_POS:
+            dispbuff[3] = SEG_OFF;  // 分钟个位
+            dispbuff[4] = SEG_OFF;  // 分钟十位
+            shownMin = 0xFF;
+            break;
+        case SEC_POS:
+            dispbuff[0] = SEG_OFF;  // 秒个位
+            dispbuff[1] = SEG_OFF;  // 秒十位
+            shownSec = 0xFF;
+            break;
+    }
+}
+
+// 只改写一位(增量刷新用，不改变版面)
+void FillDispDigit(BYTE pos, BYTE val) {
+    dispbuff[pos] = LED[val];
 }
 
 // 8位自定义显示缓冲区填充函数
 void FillCustomDispBuf8(BYTE val1, BYTE val2, BYTE val3, BYTE val4, BYTE val5, BYTE val6, BYTE val7, BYTE val8) {
-    Resetdispbuff();
+    disp_layout = DISP_LAYOUT_NONE;
     
     // 填充全部8个数字位
     dispbuff[0] = LED[val1];
@@ -160,37 +238,103 @@ void FillCustomDispBuf(BYTE val1, BYTE val2, BYTE val3, BYTE val4, BYTE val5, BY
     dispbuff[7] = SEG_OFF;
 }
 
-void disp(void) {
-    unsigned char i;
-    static unsigned char pos = 0;  // 当前扫描的位置
-    static unsigned char mark = 0x01;  // 位选掩码
-    unsigned char tmpdata;
-    
-    // 设置输出使能为高，准备数据传输
-    OE = 1;
+// 扫描用的帧：位选取自常量表，段码在 idata 中双缓冲
+// - 各模块只写 dispbuff(工作区)，扫描中断从不读它
+// - PCA_DisplayCommit 把 dispbuff 复制到后台页，再改写 dispFront 一个字节完成翻页
+// - 中断只在第0位切换到新页，一轮扫描内8位始终来自同一页
+static code const unsigned char DISP_SEL[8] = {
+    0xFE, 0xFD, 0xFB, 0xF7, 0xEF, 0xDF, 0xBF, 0x7F   // 位选(低电平有效)
+};
+static unsigned char idata dispFrame[2][8];
+static unsigned char dispFront = 0;  // 最新完整页(主循环写)
+static unsigned char dispShown = 0;  // 本轮扫描正在显示的页(中断写)
+static unsigned char dispPos = 0;    // 当前扫描的位置
+
+// B寄存器可位寻址，借它逐位输出：每位编译为 MOV C,B.n / MOV DATA,C，无分支
+sbit B_0 = B^0;
+sbit B_1 = B^1;
+sbit B_2 = B^2;
+sbit B_3 = B^3;
+sbit B_4 = B^4;
+sbit B_5 = B^5;
+sbit B_6 = B^6;
+sbit B_7 = B^7;
+
+// 从最高位开始把B移入74HC595，8位展开
+#define DISP_SHIFT_B()                  \
+    DATA = B_7; SCK = 0; SCK = 1;       \
+    DATA = B_6; SCK = 0; SCK = 1;       \
+    DATA = B_5; SCK = 0; SCK = 1;       \
+    DATA = B_4; SCK = 0; SCK = 1;       \
+    DATA = B_3; SCK = 0; SCK = 1;       \
+    DATA = B_2; SCK = 0; SCK = 1;       \
+    DATA = B_1; SCK = 0; SCK = 1;       \
+    DATA = B_0; SCK = 0; SCK = 1
+
+// 读PCA计数(主循环中使用)：读低字节时高字节进位则重读
+WORD PCA_Now(void) {
+    BYTE h, l;
     
-    // 准备位选数据（低电平有效）
-    tmpdata = ~mark;
+    do {
+        h = CH;
+        l = CL;
+    } while(h != CH);
+    return ((WORD)h << 8) | l;
+}
+
+// 打开/关闭数码管扫描：关闭时停掉模块1，既省去扫描中断也熄灭全部LED
+void PCA_DisplayEnable(bit on) {
+    if(on) {
+        value1 = PCA_Now() + TDISP;
+        CCAP1L = value1;
+        CCAP1H = value1 >> 8;
+        value1 += TDISP;
+        CCAPM1 = 0x49;
+    } else {
+        CCAPM1 = 0;
+        CCF1 = 0;                   // 丢弃已到期的一次扫描
+        OE = 1;                     // 关闭输出
+    }
+}
+
+// 把dispbuff提交给扫描中断(主循环每次调用)
+// 内容未变不翻页；中断还没切到上次提交的页时后台页仍在显示，本次跳过，
+// 下一轮主循环再提交(不等待中断)
+void PCA_DisplayCommit(void) {
+    unsigned char i, front, back;
+    bit changed = 0;
     
-    // 发送位选数据到74HC595
+    front = dispFront;
+    if(dispShown != front) {
+        return;
+    }
+    back = front ^ 1;
     for(i = 0; i < 8; i++) {
-        // 从最高位开始发送
-        DATA = (tmpdata & 0x80) ? 1 : 0;
-        SCK = 0;
-        SCK = 1;
-        tmpdata <<= 1;
+        if(dispFrame[front][i] != dispbuff[i]) {
+            changed = 1;
+        }
+        dispFrame[back][i] = dispbuff[i];
     }
+    if(changed) {
+        dispFront = back;               // 单字节写入，原子翻页
+    }
+}
+
+void disp(void) {
+    // 设置输出使能为高，准备数据传输
+    OE = 1;
     
-    // 发送段码数据到74HC595
-    tmpdata = dispbuff[pos];
-    for(i = 0; i < 8; i++) {
-        // 从最高位开始发送
-        DATA = (tmpdata & 0x80) ? 1 : 0;
-        SCK = 0;
-        SCK = 1;
-        tmpdata <<= 1;
+    // 新一轮扫描从最新的完整页开始
+    if(dispPos == 0) {
+        dispShown = dispFront;
     }
     
+    // 位选在前，段码在后
+    B = DISP_SEL[dispPos];
+    DISP_SHIFT_B();
+    B = dispFrame[dispShown][dispPos];
+    DISP_SHIFT_B();
+    
     // 锁存数据并输出
     RCK = 0;
     RCK = 1;
@@ -199,9 +343,7 @@ void disp(void) {
     OE = 0;
     
     // 移动到下一位
-    pos = (pos + 1) % 8;
-    mark = (mark << 1) | (mark >> 7);  // 循环左移
-    if(mark == 0) mark = 0x01;  // 确保非零
+    dispPos = (dispPos + 1) & 7;
 }
 
 // 时间编辑相关变量
@@ -216,57 +358,65 @@ static BYTE xdata autoToggleCounter = 0;  // 自动切换计数器
 void PCA_SetTimeEditMode(BYTE position) {
     timeEditMode = position;
     blinkState = 0;  // 开始时处于显示状态
+    DISPLAY_SHOW(DISP_VIEW_EDIT);
+    DISPLAY_INVALIDATE(DISP_VIEW_EDIT);
 }
 
-// 退出时间编辑模式
+// 退出时间编辑模式(切回下一级视图时整屏重画)
 void PCA_ExitTimeEditMode(void) {
     timeEditMode = 0;
-    // 根据当前显示模式更新显示
-    if(datetime_display_mode == DISPLAY_TIME_MODE) {
-        FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
+    DISPLAY_HIDE(DISP_VIEW_EDIT);
+}
+
+// 在 [lo, lo+range) 内按步长增减，超出范围回绕
+static BYTE WrapStep(BYTE v, BYTE lo, BYTE range, BYTE step, bit down) {
+    step %= range;
+    v -= lo;
+    if(down) {
+        v = (v >= step) ? (v - step) : (v + range - step);
     } else {
-        FillDateBuf(SysPara1.year, SysPara1.month, SysPara1.day);
+        v += step;
+        if(v >= range) v -= range;
     }
+    return v + lo;
 }
 
 // 增加时间值
 void PCA_IncreaseTimeValue(BYTE position) {
+    PCA_StepTimeValue(position, 1, 0);
+}
+
+// 按步长增减时间值(按住连发时步长加速)，各字段在自身范围内回绕
+void PCA_StepTimeValue(BYTE position, BYTE step, bit down) {
     switch (position) {
         case YEAR_POS:
-            SysPara1.year++;
-            if(SysPara1.year > 2099) SysPara1.year = 2000;  // 年份范围2000-2099
+            // 年份范围2000-2099
+            SysPara1.year = 2000 + WrapStep((BYTE)(SysPara1.year - 2000), 0, 100, step, down);
             break;
         case MONTH_POS:
-            SysPara1.month++;
-            if(SysPara1.month > 12) SysPara1.month = 1;
+            SysPara1.month = WrapStep(SysPara1.month, 1, 12, step, down);
             // 检查日期是否超出当月最大天数
             if(SysPara1.day > PCA_GetDaysInMonth(SysPara1.year, SysPara1.month)) {
                 SysPara1.day = PCA_GetDaysInMonth(SysPara1.year, SysPara1.month);
             }
             break;
         case DAY_POS:
-            SysPara1.day++;
-            if(SysPara1.day > PCA_GetDaysInMonth(SysPara1.year, SysPara1.month)) {
-                SysPara1.day = 1;
-            }
+            SysPara1.day = WrapStep(SysPara1.day, 1, PCA_GetDaysInMonth(SysPara1.year, SysPara1.month), step, down);
             break;
         case HOUR_POS:
-            SysPara1.hour = (SysPara1.hour + 1) % 24;
+            SysPara1.hour = WrapStep(SysPara1.hour, 0, 24, step, down);
             break;
         case MIN_POS:
-            SysPara1.min = (SysPara1.min + 1) % 60;
+            SysPara1.min = WrapStep(SysPara1.min, 0, 60, step, down);
             break;
         case SEC_POS:
-            SysPara1.sec = (SysPara1.sec + 1) % 60;
+            SysPara1.sec = WrapStep(SysPara1.sec, 0, 60, step, down);
             break;
     }
     
-    // 更新显示
-    if(datetime_display_mode == DISPLAY_TIME_MODE) {
-        FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
-    } else {
-        FillDateBuf(SysPara1.year, SysPara1.month, SysPara1.day);
-    }
+    // 新值立即显示，闪烁从亮开始
+    blinkState = 0;
+    DISPLAY_INVALIDATE(DISP_VIEW_EDIT);
 }
 
 // 设置时分秒
@@ -289,12 +439,7 @@ void PCA_SetTime(BYTE hour, BYTE min, BYTE sec) {
             }
         }
         
-        // 如果当前是时钟显示模式，更新显示
-        if(FlowMeter_GetMode() == FLOW_MODE_OFF && timeEditMode == 0) {
-            if(datetime_display_mode == DISPLAY_TIME_MODE) {
-                FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
-            }
-        }
+        DISPLAY_INVALIDATE(DISP_VIEW_CLOCK);
     }
 }
 
@@ -307,12 +452,7 @@ void PCA_SetDate(WORD year, BYTE month, BYTE day) {
         SysPara1.month = month;
         SysPara1.day = day;
         
-        // 如果当前是日期显示模式，更新显示
-        if(FlowMeter_GetMode() == FLOW_MODE_OFF && timeEditMode == 0) {
-            if(datetime_display_mode == DISPLAY_DATE_MODE) {
-                FillDateBuf(SysPara1.year, SysPara1.month, SysPara1.day);
-            }
-        }
+        DISPLAY_INVALIDATE(DISP_VIEW_CLOCK);
     }
 }
 
@@ -327,13 +467,7 @@ BYTE PCA_GetSec(void) { return SysPara1.sec; }
 // 显示模式控制函数
 void PCA_SetDisplayMode(BYTE mode) {
     datetime_display_mode = mode;
-    if(timeEditMode == 0) {  // 非编辑模式下立即更新显示
-        if(mode == DISPLAY_TIME_MODE) {
-            FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
-        } else {
-            FillDateBuf(SysPara1.year, SysPara1.month, SysPara1.day);
-        }
-    }
+    DISPLAY_INVALIDATE(DISP_VIEW_CLOCK);
 }
 
 // 日期计算辅助函数
@@ -395,7 +529,7 @@ void PCA_isr() interrupt 7
         CCF1 = 0;
         CCAP1L = value1;
         CCAP1H = value1 >> 8;
-        value1 += T1000Hz;
+        value1 += TDISP;
         disp(); 
     }
 
@@ -405,46 +539,26 @@ void PCA_isr() interrupt 7
         CCAP0H = value >> 8;
         value += T100Hz;
         cnt++;
+        pca_tick++;
+        Key_Tick();                 // 按键消抖与长按/连发计时
         
         if(cnt >= 100) {
             cnt = 0;
+#if FLOW_BACKEND != FLOW_BACKEND_T2
             PCA_LED = !PCA_LED;
+#endif
             
-            // 设置标志，在主循环中处理时间更新
-            time_update_flag = 1;
-            
-            // 时间编辑模式闪烁控制 - 只改变闪烁状态，不更新显示
-            if (timeEditMode > 0) {
-                blinkState = !blinkState;
-                blink_update_needed = 1;  // 设置闪烁更新标志
-            }
-            // 正常显示模式的逻辑
-            else if (FlowMeter_GetMode() == FLOW_MODE_OFF) {
-                // 时钟显示模式：实现自动轮换显示
-                if(auto_display_mode == DISPLAY_MODE_CLOCK) {
-                    // 自动轮换计数器递增
-                    autoToggleCounter++;
-                    
-                    // 每AUTO_TOGGLE_INTERVAL秒切换一次显示模式
-                    if(autoToggleCounter >= AUTO_TOGGLE_INTERVAL) {
-                        autoToggleCounter = 0;
-                        datetime_display_mode = (datetime_display_mode == DISPLAY_TIME_MODE) ? 
-                                               DISPLAY_DATE_MODE : DISPLAY_TIME_MODE;
-                    }
-                    
-                    // 设置显示更新标志
-                    display_update_needed = 1;
-                }
-                // 自动浇水参数显示模式：设置更新标志
-                else if(auto_display_mode == DISPLAY_MODE_AUTO) {
-                    display_update_flag = 1;  // 设置标志，在主循环中更新显示
-                }
+            // 累计待处理秒数，主循环阻塞期间也不丢秒(饱和于255)
+            if(pending_seconds != 0xFF) {
+                pending_seconds++;
             }
+            
+            // 显示轮换和闪烁状态只在主循环中修改，中断只投递事件
+            EVENT_POST(EVT_SECOND);
+            EVENT_POST(EVT_HALF_SECOND);
         }
-        else if(cnt % 50 == 0 && timeEditMode > 0) {
-            // 0.5秒闪烁一次 - 只改变状态，不更新显示
-            blinkState = !blinkState;
-            blink_update_needed = 1;  // 设置闪烁更新标志
+        else if(cnt == 50) {
+            EVENT_POST(EVT_HALF_SECOND);
         }
     }
 }
@@ -460,11 +574,11 @@ void PCA_Init(void)
     CMOD = 0x00;                    // Set PCA timer clock source as Fosc/12
                                     // Disable PCA timer overflow interrupt
     
-    // 初始化PCA模块1 (1000Hz)
-    value1 = T1000Hz;
+    // 初始化PCA模块1 (数码管扫描，DISP_SCAN_HZ)
+    value1 = TDISP;
     CCAP1L = value1;
     CCAP1H = value1 >> 8;           // Initial PCA module-1
-    value1 += T1000Hz;
+    value1 += TDISP;
     CCAPM1 = 0x49;                  // PCA module-1 work in 16-bit timer mode
                                     // and enable PCA interrupt
     
@@ -483,12 +597,7 @@ void PCA_Init(void)
     // 初始化显示 - 根据默认显示模式
     datetime_display_mode = DISPLAY_TIME_MODE;  // 默认显示时间
     autoToggleCounter = 0;          // 初始化自动轮换计数器
-    
-    if(datetime_display_mode == DISPLAY_TIME_MODE) {
-        FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
-    } else {
-        FillDateBuf(SysPara1.year, SysPara1.month, SysPara1.day);
-    }
+    DISPLAY_INVALIDATE(DISP_VIEW_CLOCK);
 }
 
 // 重置自动轮换计数器（在进入设置模式时调用）
@@ -496,64 +605,42 @@ void PCA_ResetAutoToggle(void) {
     autoToggleCounter = 0;
 }
 
+// 半秒事件：编辑模式下切换闪烁状态
 void PCA_ProcessBlinkUpdate(void) {
-    if(blink_update_needed) {
-        blink_update_needed = 0;
-        
-        // 根据编辑的是日期还是时间来更新显示
-        if(timeEditMode <= DAY_POS) {
-            // 编辑日期 (年月日) - 使用完整8位显示
-            FillDateBuf(SysPara1.year, SysPara1.month, SysPara1.day);
-            if (blinkState) {
-                switch (timeEditMode) {
-                    case YEAR_POS:
-                        // 年份闪烁 - 4位全部闪烁
-                        dispbuff[4] = SEG_OFF;  // 年个位
-                        dispbuff[5] = SEG_OFF;  // 年十位
-                        dispbuff[6] = SEG_OFF;  // 年百位
-                        dispbuff[7] = SEG_OFF;  // 年千位
-                        break;
-                    case MONTH_POS:
-                        // 月份闪烁
-                        dispbuff[2] = SEG_OFF;  // 月个位
-                        dispbuff[3] = SEG_OFF;  // 月十位
-                        break;
-                    case DAY_POS:
-                        // 日期闪烁
-                        dispbuff[0] = SEG_OFF;  // 日个位
-                        dispbuff[1] = SEG_OFF;  // 日十位
-                        break;
-                }
-            }
-        } else {
-            // 编辑时间 (时分秒) - 现在使用全部8位显示 HH-MM-SS
-            FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
-            if (blinkState) {
-                switch (timeEditMode) {
-                    case HOUR_POS:
-                        // 小时闪烁 (位置6-7)
-                        dispbuff[6] = SEG_OFF;  // 小时个位
-                        dispbuff[7] = SEG_OFF;  // 小时十位
-                        break;
-                    case MIN_POS:
-                        // 分钟闪烁 (位置3-4)
-                        dispbuff[3] = SEG_OFF;  // 分钟个位
-                        dispbuff[4] = SEG_OFF;  // 分钟十位
-                        break;
-                    case SEC_POS:
-                        // 秒闪烁 (位置0-1)
-                        dispbuff[0] = SEG_OFF;  // 秒个位
-                        dispbuff[1] = SEG_OFF;  // 秒十位
-                        break;
-                }
-            }
-        }
+    if(timeEditMode > 0) {
+        blinkState = !blinkState;
+        DISPLAY_INVALIDATE(DISP_VIEW_EDIT);
+    }
+}
+
+// 编辑视图：根据编辑的是日期还是时间来绘制；增量刷新只补画上次熄灭的字段，
+// 熄灭时只写该字段的2~4位
+void PCA_RenderEdit(void) {
+    if(timeEditMode <= DAY_POS) {
+        // 编辑日期 (年月日) - 使用完整8位显示
+        FillDateBuf(SysPara1.year, SysPara1.month, SysPara1.day);
+    } else {
+        // 编辑时间 (时分秒) - 使用全部8位显示 HH-MM-SS
+        FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
+    }
+    if(blinkState) {
+        BlankEditField(timeEditMode);
+    }
+}
+
+// 时钟视图：按当前显示模式绘制时间或日期
+void PCA_RenderClock(void) {
+    if(datetime_display_mode == DISPLAY_TIME_MODE) {
+        FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
+    } else {
+        FillDateBuf(SysPara1.year, SysPara1.month, SysPara1.day);
     }
 }
 
 void PCA_ProcessTimeUpdate(void) {
-    if(time_update_flag) {
-        time_update_flag = 0;
+    // 逐秒补齐：主循环被阻塞N秒，这里就执行N次
+    while(pending_seconds) {
+        pending_seconds--;      // 单字节DEC，与中断的自增不会冲突
         
         // 使用新的日期时间更新函数
         PCA_UpdateDateTime();
@@ -566,15 +653,17 @@ void PCA_ProcessTimeUpdate(void) {
     }
 }
 
+// 秒事件：时钟视图的自动轮换和刷新(被更高优先级的视图遮住时不轮换)
 void PCA_ProcessDisplayUpdate(void) {
-    if(display_update_needed) {
-        display_update_needed = 0;
-        
-        // 根据当前显示模式更新显示
-        if(datetime_display_mode == DISPLAY_TIME_MODE) {
-            FillDispBuf(SysPara1.hour, SysPara1.min, SysPara1.sec);
-        } else {
-            FillDateBuf(SysPara1.year, SysPara1.month, SysPara1.day);
-        }
+    if(Display_Top() != DISP_VIEW_CLOCK) {
+        return;
+    }
+    
+    // 每AUTO_TOGGLE_INTERVAL秒切换一次显示模式
+    if(++autoToggleCounter >= AUTO_TOGGLE_INTERVAL) {
+        autoToggleCounter = 0;
+        datetime_display_mode = (datetime_display_mode == DISPLAY_TIME_MODE) ? 
+                               DISPLAY_DATE_MODE : DISPLAY_TIME_MODE;
     }
+    DISPLAY_INVALIDATE(DISP_VIEW_CLOCK);
 }
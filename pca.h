@@ -8,10 +8,20 @@
 #define T100Hz  (FOSC / 12 / 100)
 #define T1000Hz (FOSC / 12 / 1000)
 
+// 数码管扫描频率：每次中断刷新一位，8位轮流，整屏刷新率为其1/8
+#ifndef DISP_SCAN_HZ
+#define DISP_SCAN_HZ 1000
+#endif
+#define TDISP   (FOSC / 12 / DISP_SCAN_HZ)
+
 // 类型定义
 typedef unsigned char BYTE;
 typedef unsigned int WORD;
 
+// PCA计数器(FOSC/12自由运行)，其他模块读取它作时间戳
+sfr CL = 0xE9;              // PCA base timer LOW
+sfr CH = 0xF9;              // PCA base timer HIGH
+
 // 扩展的系统参数结构体定义
 typedef struct {
     WORD year;      // 年份 (如 2025)
@@ -38,10 +48,24 @@ typedef struct {
 #define DISPLAY_TIME_MODE    0  // 显示时分秒 (HHMMSS，右侧6位)
 #define DISPLAY_DATE_MODE    1  // 显示年月日 (YYYYMMDD，全部8位)
 
+// dispbuff 当前版面：整屏重画时设置，增量刷新前据此判断自己的内容是否还在屏上
+#define DISP_LAYOUT_NONE 0    // 其他内容(自定义填充后)
+#define DISP_LAYOUT_TIME 1    // HH-MM-SS
+#define DISP_LAYOUT_DATE 2    // YYYYMMDD
+#define DISP_LAYOUT_FLOW 3    // 流量(由 flowmeter.c 设置)
+
 // 外部变量声明
 extern SYS_PARAMS SysPara1;
 extern unsigned char xdata dispbuff[8];
+extern BYTE disp_layout;            // dispbuff 当前版面
 extern BYTE datetime_display_mode;  // 日期时间显示模式
+extern BYTE datetime_display_pref;  // 串口选择的显示模式(上电时恢复)
+extern BYTE pca_tick;               // 10ms节拍计数(自由运行)
+extern WORD xdata value;            // 模块0比较值(已预先加过一个周期)
+
+// 最近一次10ms节拍对应的PCA计数值(仅在中断中使用)
+// 时间戳 = pca_tick * T100Hz + (PCA计数 - PCA_LAST_TICK)
+#define PCA_LAST_TICK() ((WORD)(value - 2 * T100Hz))
 
 // 基础函数声明
 void PCA_Init(void);                      // PCA初始化函数
@@ -49,15 +73,20 @@ void delay_ms(unsigned int ms);           // 延时函数
 void FillDispBuf(BYTE hour, BYTE min, BYTE sec); // 填充时间显示缓冲区 (6位)
 void FillDateBuf(WORD year, BYTE month, BYTE day); // 填充日期显示缓冲区 (8位)
 void SendTo595(unsigned char data_seg, unsigned char data_bit); // 发送数据到595
-void disp(void);                          // 显示函数
+void disp(void);                          // 显示函数(扫描中断中调用)
+void PCA_DisplayCommit(void);             // 把dispbuff提交给扫描中断(主循环中调用)
+void PCA_DisplayEnable(bit on);           // 打开/关闭数码管扫描(睡眠)
+WORD PCA_Now(void);                       // 读PCA计数(主循环中使用)
 void Resetdispbuff(void);                 // 重置显示缓冲区
 void FillCustomDispBuf(BYTE val1, BYTE val2, BYTE val3, BYTE val4, BYTE val5, BYTE val6); // 自定义显示缓冲区填充 (6位)
 void FillCustomDispBuf8(BYTE val1, BYTE val2, BYTE val3, BYTE val4, BYTE val5, BYTE val6, BYTE val7, BYTE val8); // 8位自定义显示缓冲区填充
+void FillDispDigit(BYTE pos, BYTE val);   // 只改写一位(增量刷新)
 
 // 时间设置相关函数声明
 void PCA_SetTimeEditMode(BYTE position);   // 设置时间编辑模式
 void PCA_ExitTimeEditMode(void);          // 退出时间编辑模式
 void PCA_IncreaseTimeValue(BYTE position); // 增加时间值
+void PCA_StepTimeValue(BYTE position, BYTE step, bit down); // 按步长增减时间值(回绕)
 void PCA_SetTime(BYTE hour, BYTE min, BYTE sec); // 设置时分秒
 void PCA_SetDate(WORD year, BYTE month, BYTE day); // 设置年月日
 void PCA_SetDateTime(WORD year, BYTE month, BYTE day, BYTE hour, BYTE min, BYTE sec); // 设置完整日期时间
@@ -85,6 +114,8 @@ void PCA_UpdateDateTime(void);            // 更新日期时间（内部调用
 void PCA_ProcessTimeUpdate(void);     // 处理时间更新（在主循环中调用）
 void PCA_ProcessDisplayUpdate(void);  // 处理显示更新（在主循环中调用）
 void PCA_ProcessBlinkUpdate(void);
+void PCA_RenderEdit(void);            // 绘制编辑视图(由 Display_Render 调用)
+void PCA_RenderClock(void);           // 绘制时钟视图(由 Display_Render 调用)
 
 
 #endif /* __PCA_H__ */
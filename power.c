@@ -0,0 +1,203 @@
+#include "power.h"
+#include "event.h"
+#include "display.h"
+#include "flowmeter.h"
+#include "i2c.h"
+#include "keyboard_control.h"
+
+#if POWER_FAIL == POWER_FAIL_LVD
+sbit ELVD = IE^6;                           // 低压检测中断允许
+#define LVDF 0x20                           // PCON.5 低压检测标志，软件清零
+#endif
+
+BYTE xdata power_sleep_start = POWER_SLEEP_START;
+BYTE xdata power_sleep_end = POWER_SLEEP_END;
+
+static bit sleeping = 0;                    // 数码管已关闭
+static BYTE xdata wakeSeconds = 0;          // 亮屏剩余秒数
+static unsigned long xdata idleCounts = 0;  // 本秒空闲的PCA计数(FOSC/12)
+static WORD xdata awakeLast = 1000;         // 上一秒醒着的千分比
+static unsigned long xdata awakeSum = 0;    // 每秒千分比之和
+static unsigned long xdata dutySeconds = 0; // 参与统计的秒数
+static unsigned long xdata sleepSeconds = 0;
+static WORD xdata failCount = 0;            // 掉电中断次数
+#if POWER_FAIL != POWER_FAIL_NONE
+bit power_fail_pending = 0;
+static BYTE xdata powerGoodSec = 0;         // 掉电后电压连续正常的秒数
+#endif
+
+void Power_Init(void) {
+    sleeping = 0;
+    wakeSeconds = POWER_WAKE_SECONDS;
+    idleCounts = 0;
+    awakeLast = 1000;
+    awakeSum = 0;
+    dutySeconds = 0;
+    sleepSeconds = 0;
+    failCount = 0;
+    
+#if POWER_FAIL != POWER_FAIL_NONE
+    powerGoodSec = 0;
+#endif
+#if POWER_FAIL == POWER_FAIL_LVD
+    PCON &= ~LVDF;                  // 上电过程中置位的标志不算
+    ELVD = 1;
+#elif POWER_FAIL == POWER_FAIL_INT1
+    IT1 = 1;                        // 下降沿
+    IE1 = 0;
+    EX1 = 1;
+#endif
+}
+
+// 掉电中断只置标志并关闭自身(电压低时标志一直置位)，电压恢复后由 Power_Second 重新开启
+#if POWER_FAIL == POWER_FAIL_LVD
+void LVD_ISR() interrupt 6 {
+    ELVD = 0;
+    power_fail_pending = 1;
+}
+#elif POWER_FAIL == POWER_FAIL_INT1
+void INT1_ISR() interrupt 2 {
+    EX1 = 0;
+    power_fail_pending = 1;
+}
+#endif
+
+// 电源跌落：先关数码管省电，再提交一条累计流量记录(浇水中另写会话结束页)并等写完。
+// 数码管扫描停止后只剩10ms节拍能唤醒空闲，等待期间改为连续查询应答，写周期结束后
+// 立即发送下一页，不会每页多等最多10ms。影子区的设置页不在此时写回
+// (停止修改3秒后才写回，掉电前3秒内的设置修改会丢失)；
+// 电压若又恢复，数码管照常点亮，持续正常 POWER_REARM_SEC 秒后重新开启检测
+void Power_Fail(void) {
+#if POWER_FAIL != POWER_FAIL_NONE
+    power_fail_pending = 0;
+#endif
+    if(failCount != 0xFFFF) {
+        failCount++;
+    }
+    PCA_DisplayEnable(0);
+    EEPROM_BusyPoll(1);
+    if(FlowMeter_HasUnsavedChanges()) {
+        FlowMeter_ForceSave();
+    }
+    WateringSession_PowerFail();    // 浇水中：记下掉电时刻，上电补出记录
+    EEPROM_Drain();
+    EEPROM_BusyPoll(0);
+    if(!sleeping) {
+        PCA_DisplayEnable(1);
+    }
+}
+
+WORD Power_GetFails(void) {
+    return failCount;
+}
+
+// 退出睡眠并重新计时亮屏
+void Power_Wake(void) {
+    wakeSeconds = POWER_WAKE_SECONDS;
+    if(sleeping) {
+        sleeping = 0;
+        PCA_DisplayEnable(1);
+    }
+}
+
+// 空闲：中断返回后从 IDL 的下一条指令继续。查询队列与进入空闲之间若有中断
+// 投递事件，最迟下一个扫描中断唤醒后处理。唤醒中断本身的执行时间计入空闲
+void Power_Idle(void) {
+    WORD t;
+
+    if(sleeping && Display_Top() != DISP_VIEW_CLOCK) {
+        Power_Wake();               // 开始浇水等，立即亮屏
+    }
+    if(evt_head != evt_tail) {
+        return;
+    }
+#if POWER_FAIL != POWER_FAIL_NONE
+    if(power_fail_pending) {
+        return;
+    }
+#endif
+    t = PCA_Now();
+    PCON |= 0x01;                   // IDL
+    idleCounts += (WORD)(PCA_Now() - t);
+}
+
+// 小时是否在睡眠时段内
+static bit InSleepWindow(BYTE hour) {
+    if(power_sleep_start == POWER_SLEEP_OFF) {
+        return 0;
+    }
+    if(power_sleep_start == power_sleep_end) {
+        return 1;
+    }
+    if(power_sleep_start < power_sleep_end) {
+        return hour >= power_sleep_start && hour < power_sleep_end;
+    }
+    return hour >= power_sleep_start || hour < power_sleep_end;
+}
+
+void Power_Second(void) {
+    unsigned long idle;
+    
+    // 掉电检测关闭期间：电压仍低则清零计时，缓慢跌落或在阈值附近波动时
+    // 不会每秒重复保存
+#if POWER_FAIL == POWER_FAIL_LVD
+    if(!ELVD) {
+        if(PCON & LVDF) {
+            PCON &= ~LVDF;          // 电压仍低时硬件再次置位
+            powerGoodSec = 0;
+        } else if(++powerGoodSec >= POWER_REARM_SEC) {
+            powerGoodSec = 0;
+            ELVD = 1;
+        }
+    }
+#elif POWER_FAIL == POWER_FAIL_INT1
+    if(!EX1) {
+        if(!INT1) {                 // 比较器输出仍为低
+            powerGoodSec = 0;
+        } else if(++powerGoodSec >= POWER_REARM_SEC) {
+            powerGoodSec = 0;
+            IE1 = 0;
+            EX1 = 1;
+        }
+    }
+#endif
+
+    // 空闲计数换算为千分比：一秒 FOSC/12 个计数，idle*10/9216
+    idle = idleCounts * 10 / (FOSC / 12 / 100);
+    idleCounts = 0;
+    if(idle > 1000) {
+        idle = 1000;
+    }
+    awakeLast = 1000 - (WORD)idle;
+    awakeSum += awakeLast;
+    if(++dutySeconds >= 86400UL) {  // 满一天后减半，较早的数据权重逐日减半，且不溢出
+        awakeSum >>= 1;
+        dutySeconds >>= 1;
+    }
+
+    if(wakeSeconds) {
+        wakeSeconds--;
+    }
+    if(!sleeping && wakeSeconds == 0 && InSleepWindow(SysPara1.hour) &&
+       Display_Top() == DISP_VIEW_CLOCK) {
+        sleeping = 1;
+        PCA_DisplayEnable(0);
+    } else if(sleeping && !InSleepWindow(SysPara1.hour)) {
+        Power_Wake();
+    }
+    if(sleeping) {
+        sleepSeconds++;
+    }
+}
+
+WORD Power_GetAwakeLast(void) {
+    return awakeLast;
+}
+
+WORD Power_GetAwakeAvg(void) {
+    return dutySeconds ? (WORD)(awakeSum / dutySeconds) : awakeLast;
+}
+
+unsigned long Power_GetSleepSeconds(void) {
+    return sleepSeconds;
+}
@@ -0,0 +1,73 @@
+#ifndef __POWER_H__
+#define __POWER_H__
+
+#include "reg51.h"
+#include "pca.h"
+
+/*
+ * 低功耗
+ * - 主循环每轮末尾 Power_Idle：事件队列为空时进入空闲(PCON.IDL)，
+ *   PCA、INT0、T2、UART 中断唤醒；数码管扫描每 1/DISP_SCAN_HZ 秒唤醒一次，
+ *   主循环的响应延迟不超过一个扫描周期
+ * - 睡眠时段(可选)：时段内时钟视图在前台(不在浇水、设置)时关闭数码管扫描，
+ *   CPU 只被10ms节拍唤醒；按键或串口命令后亮屏 POWER_WAKE_SECONDS 秒。
+ *   掉电模式(PCON.PD)会停振，软件时钟无法走时，因此不用
+ * - 占空比：每秒统计主循环醒着的比例，串口 DUTY 命令输出
+ */
+
+/*
+ * 掉电保存：电源跌落时中断置 power_fail_pending(不经事件队列，队列满也不会丢)，
+ * 主循环每轮开头、以及会等待较久的循环(UART_SendByte 等发送队列、EEPROM_Flush、
+ * 读总线前等写周期)中用 POWER_FAIL_CHECK 检查，随即执行 Power_Fail：关数码管减小电流，
+ * 写入一条累计流量日志记录，浇水中再写一页会话结束信息(见 keyboard_control.c)，
+ * 等待写完，在储能电容放完前完成。通常一到两个写周期(5~10ms/个)；恰逢写回或
+ * 日志写入进行中时最多 3+EEPROM_JOB_NUM 个写周期(只在刚开始浇水时)，储能按
+ * 最坏情况(5×10ms)设计。影子区中未写回的设置页不在掉电时写入
+ * - POWER_FAIL_LVD：片内低压检测(STC89C5xRC：ELVD=IE.6，LVDF=PCON.5，中断6)
+ * - POWER_FAIL_INT1：P3.3 接外部电源比较器(下降沿)，P3.3 不再作按键
+ * - POWER_FAIL_NONE：不检测，累计流量仍按短间隔定期保存(默认)
+ * 选用 LVD/INT1 后定期保存放宽到15分钟，须确认硬件上检测确实有效，
+ * 否则掉电最多丢失15分钟的流量
+ */
+#define POWER_FAIL_NONE     0
+#define POWER_FAIL_LVD      1
+#define POWER_FAIL_INT1     2
+#ifndef POWER_FAIL
+#define POWER_FAIL          POWER_FAIL_NONE
+#endif
+
+#if POWER_FAIL != POWER_FAIL_NONE
+extern bit power_fail_pending;        // 掉电中断已触发，尚未保存
+// Power_Fail 及其调用的函数不能再调用含本检查的函数(C51 函数不可重入)
+#define POWER_FAIL_CHECK()  { if(power_fail_pending) Power_Fail(); }
+#else
+#define POWER_FAIL_CHECK()
+#endif
+
+#define POWER_REARM_SEC     5     // 电压恢复并持续5秒后才重新开启掉电检测(一次跌落只保存一次)
+
+#define POWER_SLEEP_OFF     0xFF  // 不启用睡眠时段
+#define POWER_WAKE_SECONDS  30    // 用户操作后亮屏时间(秒)
+
+// 默认睡眠时段 [开始小时, 结束小时)，可跨午夜，两者相等表示全天
+#ifndef POWER_SLEEP_START
+#define POWER_SLEEP_START   POWER_SLEEP_OFF
+#endif
+#ifndef POWER_SLEEP_END
+#define POWER_SLEEP_END     6
+#endif
+
+extern BYTE xdata power_sleep_start;  // 睡眠开始小时，POWER_SLEEP_OFF=不睡眠
+extern BYTE xdata power_sleep_end;    // 睡眠结束小时
+
+void Power_Init(void);
+void Power_Idle(void);                // 无事可做时空闲等待中断(主循环每轮调用)
+void Power_Second(void);              // 秒事件：占空比统计、睡眠时段判断
+void Power_Wake(void);                // 用户操作：亮屏并推迟睡眠
+void Power_Fail(void);                // 掉电：最后一次保存(经 POWER_FAIL_CHECK 调用)
+WORD Power_GetFails(void);            // 掉电中断次数
+WORD Power_GetAwakeLast(void);        // 上一秒醒着的比例(千分比)
+WORD Power_GetAwakeAvg(void);         // 上电以来醒着的平均比例(千分比)
+unsigned long Power_GetSleepSeconds(void); // 关屏睡眠累计秒数
+
+#endif /* __POWER_H__ */
@@ -2,7 +2,6 @@
 #include "pca.h"  
 
 // 继电器控制引脚定义
-sbit RELAY_CTRL = P1^1;  // 继电器控制引脚 - 低电平时继电器闭合
 sbit RELAY_NODE1 = P1^0; // 继电器常开节点连接的第一个引脚 - 连接到方波发生器输出，模拟流量计信号输出
 sbit RELAY_NODE2 = P3^2; // 继电器常开节点连接的第二个引脚 - 连接到INT0，用于捕获流量计脉冲
 
@@ -8,6 +8,11 @@
 #define RELAY_IN1  P1_0  // 继电器常开节点连接的第一个引脚
 #define RELAY_IN2  P3_2  // 继电器常开节点连接的第二个引脚
 
+sbit RELAY_CTRL = P1^1;  // 继电器控制引脚 - 低电平时继电器闭合
+
+// 中断中关阀：直接写引脚，不调用函数(中断与主程序不共用函数)
+#define RELAY_OFF_ISR() (RELAY_CTRL = 1)
+
 // 函数声明
 void Relay_Init(void);                    // 继电器初始化
 void Relay_On(void);                      // 开启继电器（低电平吸合）
@@ -0,0 +1,108 @@
+#include "sched.h"
+#include "event.h"
+
+typedef struct {
+    BYTE period;        // 周期(节拍)，0=事件触发
+    BYTE deadline;      // 从就绪到执行完的期限(节拍)
+} SCHED_TASK;
+
+// 顺序与 TASK_xxx 一致
+static code const SCHED_TASK schedTable[SCHED_TASKS] = {
+    { 0,  5 },          // TASK_EVENTS   按键响应不超过50ms
+    { 0, 10 },          // TASK_SECOND
+    { 0, 10 },          // TASK_BLINK
+    { 0, 20 },          // TASK_UART_CMD
+    { 1,  3 },          // TASK_FLOW     每10ms
+    { 1,  3 },          // TASK_EEPROM   每10ms
+    { 2, 10 },          // TASK_UART_TX  每20ms
+    { 2,  3 },          // TASK_DISPLAY  每20ms
+};
+
+BYTE sched_ready = 0;
+static BYTE xdata taskNext[SCHED_TASKS];     // 周期任务下次释放的节拍
+static BYTE xdata taskRelease[SCHED_TASKS];  // 本次就绪的节拍
+static WORD xdata taskMisses[SCHED_TASKS];
+static BYTE xdata taskWorst[SCHED_TASKS];
+
+void Sched_Init(void) {
+    BYTE i, now;
+
+    now = pca_tick;
+    sched_ready = 0;
+    for(i = 0; i < SCHED_TASKS; i++) {
+        taskNext[i] = now + schedTable[i].period;
+        taskRelease[i] = now;
+        taskMisses[i] = 0;
+        taskWorst[i] = 0;
+    }
+}
+
+static void CountMiss(BYTE task) {
+    if(taskMisses[task] != 0xFFFF) {
+        taskMisses[task]++;
+    }
+}
+
+// 已就绪时保留最早的就绪时刻
+void Sched_Trigger(BYTE task) {
+    BYTE m = 1 << task;
+
+    if(!(sched_ready & m)) {
+        sched_ready |= m;
+        taskRelease[task] = pca_tick;
+    }
+}
+
+BYTE Sched_Next(void) {
+    BYTE i, m, now, period;
+
+    if(evt_head != evt_tail) {
+        Sched_Trigger(TASK_EVENTS);
+    }
+
+    now = pca_tick;
+    for(i = 0, m = 1; i < SCHED_TASKS; i++, m <<= 1) {
+        period = schedTable[i].period;
+        if(period == 0 || (signed char)(now - taskNext[i]) < 0) {
+            continue;
+        }
+        if(sched_ready & m) {
+            CountMiss(i);               // 上次释放还没轮到执行
+        } else {
+            sched_ready |= m;
+            taskRelease[i] = taskNext[i];
+        }
+        taskNext[i] += period;
+        if((signed char)(now - taskNext[i]) >= 0) {
+            taskNext[i] = now + period; // 落后一个周期以上，不补跑
+        }
+    }
+
+    if(sched_ready == 0) {
+        return TASK_NONE;
+    }
+    for(i = 0, m = 1; !(sched_ready & m); i++, m <<= 1) {
+    }
+    return i;
+}
+
+void Sched_Done(BYTE task) {
+    BYTE late;
+
+    sched_ready &= ~(1 << task);
+    late = pca_tick - taskRelease[task];
+    if(late > taskWorst[task]) {
+        taskWorst[task] = late;
+    }
+    if(late > schedTable[task].deadline) {
+        CountMiss(task);
+    }
+}
+
+WORD Sched_GetMisses(BYTE task) {
+    return taskMisses[task];
+}
+
+BYTE Sched_GetWorst(BYTE task) {
+    return taskWorst[task];
+}
@@ -0,0 +1,39 @@
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include "reg51.h"
+#include "pca.h"
+
+/*
+ * 协作式调度：以PCA 10ms节拍(pca_tick)为时基的任务表
+ * - 周期任务：到了释放时刻即就绪，下次释放时刻按周期推进；
+ *   落后超过一个周期时不补跑，从当前节拍重新计时
+ * - 事件任务：周期为0，主循环收到对应事件时 Sched_Trigger 置就绪
+ * - 主循环每次取表中最靠前(优先级最高)的一个就绪任务执行，执行完
+ *   Sched_Done 检查从就绪到完成的节拍数，超过期限记一次超时并记录最大延迟；
+ *   任务尚未执行又到了下次释放也记一次超时
+ * - 任务不可抢占，某个任务执行过久会推迟其它任务，串口 SCHED 命令查看统计
+ */
+
+// 任务号即优先级，数值小的先执行
+#define TASK_EVENTS     0   // 事件分发(按键、达量关阀)，事件队列非空时就绪
+#define TASK_SECOND     1   // 秒：时钟、定时浇水、流量统计、显示轮换、功耗统计
+#define TASK_BLINK      2   // 半秒：编辑项闪烁
+#define TASK_UART_CMD   3   // 串口命令解析
+#define TASK_FLOW       4   // 流速估计
+#define TASK_EEPROM     5   // EEPROM异步写入
+#define TASK_UART_TX    6   // 输出浇水记录
+#define TASK_DISPLAY    7   // 显示合成与提交
+#define SCHED_TASKS     8
+#define TASK_NONE       0xFF
+
+extern BYTE sched_ready;            // 就绪任务(位号为任务号)
+
+void Sched_Init(void);
+void Sched_Trigger(BYTE task);      // 事件任务就绪(主循环中调用)
+BYTE Sched_Next(void);              // 释放到期的周期任务，返回优先级最高的就绪任务
+void Sched_Done(BYTE task);         // 任务执行完，检查期限
+WORD Sched_GetMisses(BYTE task);    // 超时次数(饱和于65535)
+BYTE Sched_GetWorst(BYTE task);     // 从就绪到完成的最大节拍数
+
+#endif /* __SCHED_H__ */
@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "reg51.h"
+#include "bcd.h"
+
+/*
+ * ========================================
+ * 数码管取位基准(主机端)
+ * ========================================
+ *
+ * 对比流量显示两种取位方式：
+ *   div : 原写法，7位数字各做一次 / 与 % (8051 上每次都是 ?C?ULDIV 库调用)
+ *   bcd : 累计值维护压缩BCD镜像，每秒按增量 BCD_Add，显示时直接取半字节；
+ *         当前流量每次 BCD_FromULong 重新转换
+ * 主机有硬件除法器，直接用 / % 不能反映 8051 的开销；这里的 div 路径改用
+ * 与 ?C?ULDIV 相同的32轮移位相减算法，作为8051上相对耗时的近似。
+ *
+ * 另对比串口数值输出：原 SendNumber(逐位 / %，只输出低5位)与 BCD_Format(10位)。
+ * 主机上的耗时不代表8051，两条路径都按执行的32位基本操作计数，再用同一张
+ * 机器周期表(op_cycles，按 Keil 生成的指令序列估算)折算，结果是估计值而非实测。
+ * 两种方式的结果逐次比对，不一致时返回1。
+ */
+
+// 32位基本操作及其在8051上的机器周期估计(12T，每个机器周期12个时钟)
+enum { OP_CMP32, OP_SUB32, OP_SHL64, OP_LDCODE32, OP_LOOP, OP_CALL, OP_STORE, OP_NUM };
+static const struct {
+    const char *name;
+    unsigned cycles;
+} op_cycles[OP_NUM] = {
+    { "cmp32",    10 },     // CLR C + 4×(MOV A,x / SUBB A,y) + 条件跳转
+    { "sub32",    13 },     // CLR C + 4×(MOV A,x / SUBB A,y / MOV x,A)
+    { "shl64",    25 },     // CLR C + 8×(MOV A,Rn / RLC A / MOV Rn,A)，?C?ULDIV 每轮移位
+    { "ldcode32", 22 },     // 下标换算 + 4×(CLR A / MOVC / MOV)，从 code 表取10的幂
+    { "loop",      3 },     // 计数/DJNZ 或 INC + SJMP
+    { "call",     20 },     // 装入8字节参数 + LCALL + RET
+    { "store",     4 },     // 写一个字符到缓冲区(含指针加1)
+};
+static unsigned long op_count[OP_NUM];
+#define OP(o)   (op_count[o]++)
+
+static unsigned long op_total_cycles(void) {
+    unsigned long c = 0;
+    int i;
+    for(i = 0; i < OP_NUM; i++) c += op_count[i] * op_cycles[i].cycles;
+    return c;
+}
+
+static volatile uint32_t divisor[7] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+static volatile unsigned char sink;
+static unsigned long uldiv_calls;
+
+// 32位无符号除法，逐位移位相减(8051 无除法指令，库函数同样如此实现)
+static uint32_t uldiv(uint32_t a, uint32_t b, uint32_t *rem) {
+    uint32_t q = 0, r = 0;
+    int i;
+    uldiv_calls++;
+    OP(OP_CALL);
+    for(i = 31; i >= 0; i--) {
+        OP(OP_LOOP);
+        OP(OP_SHL64);
+        OP(OP_CMP32);
+        r = (r << 1) | ((a >> i) & 1);
+        if(r >= b) {
+            OP(OP_SUB32);
+            r -= b;
+            q |= (uint32_t)1 << i;
+        }
+    }
+    *rem = r;
+    return q;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 与原 UpdateTotalFlowDisplay 相同：1次取模 + 6次(除法+取模)
+static void digits_div(uint32_t v, unsigned char *d) {
+    uint32_t r;
+    unsigned char i;
+    uldiv(v, divisor[1], &r);
+    d[0] = (unsigned char)r;
+    for(i = 1; i < 7; i++) {
+        uldiv(uldiv(v, divisor[i], &r), divisor[1], &r);
+        d[i] = (unsigned char)r;
+    }
+}
+
+// 原 SendNumber 的取位方式(万位以上丢失)
+static unsigned char send_number_div(uint32_t num, char *out) {
+    uint32_t r;
+    unsigned char n = 0;
+    op_count[OP_CMP32] += 4;                // 4个 if 的比较
+    op_count[OP_STORE] += (num >= 10000) + (num >= 1000) + (num >= 100) + (num >= 10) + 1;
+    if(num >= 10000) { uldiv(uldiv(num, divisor[4], &r), divisor[1], &r); out[n++] = '0' + r; }
+    if(num >= 1000) { uldiv(uldiv(num, divisor[3], &r), divisor[1], &r); out[n++] = '0' + r; }
+    if(num >= 100) { uldiv(uldiv(num, divisor[2], &r), divisor[1], &r); out[n++] = '0' + r; }
+    if(num >= 10) { uldiv(uldiv(num, divisor[1], &r), divisor[1], &r); out[n++] = '0' + r; }
+    uldiv(num, divisor[1], &r);
+    out[n++] = '0' + r;
+    out[n] = 0;
+    return n;
+}
+
+// 与 BCD_Format 相同的算法，按基本操作计数(结果与 BCD_Format 比对)
+static unsigned char format_counted(char *buf, uint32_t v) {
+    static const uint32_t pow10[10] = {
+        1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL,
+        100000000UL, 1000000000UL
+    };
+    unsigned char n = 9, len;
+    char d;
+
+    OP(OP_CALL);
+    for(;;) {                               // 跳过前导零
+        OP(OP_LOOP);
+        if(n == 0) break;
+        OP(OP_LDCODE32);
+        OP(OP_CMP32);
+        if(v >= pow10[n]) break;
+        n--;
+    }
+    len = n + 1;
+    for(;;) {
+        d = '0';
+        for(;;) {
+            OP(OP_LDCODE32);                // 每次比较重新从 code 表取
+            OP(OP_CMP32);
+            if(v < pow10[n]) break;
+            OP(OP_SUB32);
+            OP(OP_LOOP);
+            v -= pow10[n];
+            d++;
+        }
+        OP(OP_STORE);
+        *buf++ = d;
+        OP(OP_LOOP);
+        if(n == 0) break;
+        n--;
+    }
+    *buf = '\0';
+    return len;
+}
+
+// 数值输出基准：返回0表示结果全部正确
+static int bench_format(void) {
+    enum { N = 1000000 };
+    static const uint64_t range[10] = {
+        10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+        100000000ULL, 1000000000ULL, 0x100000000ULL
+    };
+    static uint32_t val[N];
+    char buf[BCD_FORMAT_SIZE], ref[16];
+    double t0, t_div, t_fmt, cyc_div, cyc_fmt;
+    unsigned long i;
+    unsigned char len;
+
+    for(i = 0; i < N; i++) {
+        // 位数均匀分布：1~10位
+        val[i] = (uint32_t)((((uint64_t)rand() << 31) ^ rand()) % range[i % 10]);
+    }
+    val[0] = 0;
+    val[1] = 0xFFFFFFFFUL;
+    val[2] = 1234567;
+
+    t0 = now();
+    for(i = 0; i < N; i++) {
+        send_number_div(val[i], ref);
+        sink = ref[0];
+    }
+    t_div = now() - t0;
+
+    t0 = now();
+    for(i = 0; i < N; i++) {
+        BCD_Format(buf, val[i]);
+        sink = buf[0];
+    }
+    t_fmt = now() - t0;
+
+    for(i = 0; i < N; i++) {
+        len = BCD_Format(buf, val[i]);
+        snprintf(ref, sizeof(ref), "%u", val[i]);
+        if(strcmp(buf, ref) != 0 || len != strlen(ref)) {
+            fprintf(stderr, "bench: BCD_Format(%u) = \"%s\"\n", val[i], buf);
+            return 1;
+        }
+    }
+
+    // 同一张周期表折算两条路径
+    memset(op_count, 0, sizeof(op_count));
+    for(i = 0; i < N; i++) send_number_div(val[i], ref);
+    cyc_div = (double)op_total_cycles() / N;
+    memset(op_count, 0, sizeof(op_count));
+    for(i = 0; i < N; i++) {
+        format_counted(ref, val[i]);
+        BCD_Format(buf, val[i]);
+        if(strcmp(buf, ref) != 0) {
+            fprintf(stderr, "bench: format_counted(%u) = \"%s\"\n", val[i], ref);
+            return 1;
+        }
+    }
+    cyc_fmt = (double)op_total_cycles() / N;
+    send_number_div(1234567, ref);
+
+    printf("number format, %d values of 1-10 digits (host ns per number; estimated 8051 machine cycles per number)\n", N);
+    printf("  SendNumber div : %6.1f ns  ~%6.0f cycles  (\"%s\" for 1234567)\n",
+           t_div * 1e9 / N, cyc_div, ref);
+    printf("  BCD_Format     : %6.1f ns  ~%6.0f cycles  (x%.1f host, x%.1f est.)\n",
+           t_fmt * 1e9 / N, cyc_fmt, t_div / t_fmt, cyc_div / cyc_fmt);
+    printf("  cost table     :");
+    for(i = 0; i < OP_NUM; i++) printf(" %s %u", op_cycles[i].name, op_cycles[i].cycles);
+    printf("\n");
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    enum { N = 2000000 };
+    static uint32_t delta[N];
+    unsigned char bcd[BCD_BYTES], d[7];
+    uint32_t total, start = 1234567;
+    double t0, t_div, t_bcd, t_cur_div, t_cur_bcd;
+    unsigned long i;
+    unsigned char k;
+
+    (void)argc;
+    (void)argv;
+    srand(51);
+    for(i = 0; i < N; i++) delta[i] = rand() % 2000;       // 每秒增量：0~2L
+
+    // 累计流量：每秒累加一次并刷新显示
+    t0 = now();
+    for(i = 0, total = start; i < N; i++) {
+        total += delta[i];
+        digits_div(total, d);
+        sink = d[0] ^ d[6];
+    }
+    t_div = now() - t0;
+
+    t0 = now();
+    BCD_FromULong(bcd, start);
+    for(i = 0; i < N; i++) {
+        BCD_Add(bcd, delta[i]);
+        for(k = 0; k < 7; k++) d[k] = BCD_DIGIT(bcd, k);
+        sink = d[0] ^ d[6];
+    }
+    t_bcd = now() - t0;
+
+    // 当前流量：每次从二进制值重新转换
+    t0 = now();
+    for(i = 0; i < N; i++) {
+        digits_div(delta[i] * 37, d);
+        sink = d[0] ^ d[6];
+    }
+    t_cur_div = now() - t0;
+
+    t0 = now();
+    for(i = 0; i < N; i++) {
+        BCD_FromULong(bcd, delta[i] * 37);
+        for(k = 0; k < 7; k++) d[k] = BCD_DIGIT(bcd, k);
+        sink = d[0] ^ d[6];
+    }
+    t_cur_bcd = now() - t0;
+
+    // 结果比对
+    BCD_FromULong(bcd, start);
+    for(i = 0, total = start; i < N; i++) {
+        unsigned char ref[7];
+        total += delta[i];
+        BCD_Add(bcd, delta[i]);
+        digits_div(total, ref);
+        for(k = 0; k < 7; k++) {
+            if(ref[k] != BCD_DIGIT(bcd, k)) {
+                fprintf(stderr, "bench: mismatch at %lu total %u digit %u\n", i, total, k);
+                return 1;
+            }
+        }
+    }
+
+    printf("display digits, %d refreshes (host ns per refresh; 32-bit divisions per refresh)\n", N);
+    printf("  total   div : %6.1f ns  %lu calls\n", t_div * 1e9 / N, uldiv_calls / (3UL * N));
+    printf("  total   bcd : %6.1f ns   0 calls  (x%.1f)\n", t_bcd * 1e9 / N, t_div / t_bcd);
+    printf("  current div : %6.1f ns  %lu calls\n", t_cur_div * 1e9 / N, uldiv_calls / (3UL * N));
+    printf("  current bcd : %6.1f ns   0 calls  (x%.1f)\n", t_cur_bcd * 1e9 / N, t_cur_div / t_cur_bcd);
+    return bench_format();
+}
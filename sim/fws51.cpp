@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "sim51.h"
+#include "pca.h"
+
+/*
+ * ========================================
+ * 浇水系统主机仿真器 - 命令行入口
+ * ========================================
+ *
+ * 用法: fws51 [选项]
+ *   -d DAYS        仿真天数
+ *   -s SECONDS     仿真秒数(与 -d 累加)
+ *   -w             空闲快进：继电器断开、串口空闲、无待处理输入时
+ *                  每个主循环直接推进到下一秒
+ *   -v             将串口输出打印到标准输出
+ *   -r T:TEXT      第 T 秒从串口输入一行命令(自动补回车)
+ *   -g MS          串口输入字符间隔(默认0，即整行连续到达)
+ *   -k KEY@T[+MS]  第 T 秒按下按键并保持 MS 毫秒(默认100)
+ *                  KEY: AUTO TUP TDOWN VUP VDOWN MODE KEY(P3.3)
+ *   -e FILE        24C02 内容映像(启动时读取，结束时写回)
+ *   -t MS          24C02 写周期(默认5ms)
+ *   -p HZ          外部流量传感器脉冲频率(默认使用 P1.0 的 5Hz 方波)
+ *   -f T[+MS]      第 T 秒电源跌落(置低压检测标志)，MS 毫秒后断电结束(默认20)
+ *   -l T+S         第 T 秒起电压偏低 S 秒但不断电(期间低压检测标志清除后1ms内再次置位)
+ *   -a N / -m N    期望的自动/手动浇水记录数，不符时返回1
+ */
+
+// 固件符号
+void fw_main(void);
+void PCA_isr(void);
+void T0_ISR(void);
+// 两种脉冲计数方式只编译其一，未编译的中断函数为空
+void INT0_ISR(void) __attribute__((weak));
+void T2_ISR(void) __attribute__((weak));
+// 掉电检测按 POWER_FAIL 只编译其一
+void LVD_ISR(void) __attribute__((weak));
+void INT1_ISR(void) __attribute__((weak));
+void UART_ISR(void);
+extern BYTE cnt;
+
+// 固件空循环延时由仿真器接管
+void delay_ms(WORD ms) {
+    sim_delay_ms(ms);
+}
+
+/* ---------- 按键 ---------- */
+struct key_def {
+    const char *name;
+    unsigned char port;
+    unsigned char pin;
+};
+
+static const key_def keys[] = {
+    {"AUTO", 1, 2}, {"TUP", 1, 3}, {"TDOWN", 1, 4}, {"VUP", 1, 5},
+    {"VDOWN", 1, 6}, {"MODE", 1, 7}, {"KEY", 3, 3},
+};
+static unsigned char keys_held;
+
+static void key_down(void *arg) {
+    const key_def *k = (const key_def *)arg;
+    sim_pin_drive(k->port, k->pin, 0);
+    keys_held++;
+}
+
+static void key_up(void *arg) {
+    const key_def *k = (const key_def *)arg;
+    sim_pin_drive(k->port, k->pin, 1);
+    keys_held--;
+}
+
+/* ---------- 串口输出 ---------- */
+static bool uart_echo;
+static char line[128];
+static unsigned char line_len;
+static unsigned long auto_records, manual_records;
+
+static void uart_tx(unsigned char ch) {
+    if(uart_echo) fputc(ch, stdout);
+    if(ch == '\n' || line_len == sizeof(line) - 1) {
+        line[line_len] = 0;
+        if(strncmp(line, "Type: Auto Watering", 19) == 0) auto_records++;
+        if(strncmp(line, "Type: Manual Watering", 21) == 0) manual_records++;
+        line_len = 0;
+    } else if(ch != '\r') {
+        line[line_len++] = ch;
+    }
+}
+
+/* ---------- 空闲快进 ---------- */
+static bool warp;
+static unsigned long warp_steps;
+
+static bool sim_idle(void) {
+    return !sim_relay_closed() && !sim_uart_busy() && !keys_held &&
+           sim_next_scheduled() > sim_cycles + SIM_SEC(2);
+}
+
+// 把本秒剩余的100Hz节拍折叠掉：PCA计数器冻结，节拍计数直接补齐；
+// 再直接跳到模块0的下一次匹配，期间模块1(数码管扫描)不参与
+static bool warp_delay(unsigned int ms) {
+    (void)ms;
+    if(!warp || !sim_idle()) return false;
+    if(cnt < 99) {
+        sim_pca_skip((uint64_t)(99 - cnt) * T100Hz, 0x03);
+        cnt = 99;
+    }
+    sim_pca_skip(sim_pca_next_match(0) - sim_cycles, 0x02);
+    warp_steps++;
+    return true;
+}
+
+// 主循环空闲(PCON.IDL)时同样快进
+static bool warp_idle(void) {
+    return warp_delay(0);
+}
+
+/* ---------- 主程序 ---------- */
+static void usage(void) {
+    fprintf(stderr, "usage: fws51 [-d days] [-s sec] [-w] [-v] [-g ms] [-r T:TEXT] [-k KEY@T[+MS]]\n"
+                    "             [-e eeprom.bin] [-t twr_ms] [-p pulse_hz] [-f T[+MS]] [-l T+S] [-a auto] [-m manual]\n");
+    exit(2);
+}
+
+static void schedule_key(const char *spec) {
+    char name[16];
+    const char *at = strchr(spec, '@');
+    const char *plus;
+    double t, hold = 100;
+    unsigned int i;
+
+    if(!at || at - spec >= (int)sizeof(name)) usage();
+    memcpy(name, spec, at - spec);
+    name[at - spec] = 0;
+    t = atof(at + 1);
+    plus = strchr(at, '+');
+    if(plus) hold = atof(plus + 1);
+
+    for(i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        if(strcmp(keys[i].name, name) == 0) {
+            sim_at(SIM_SEC(t), key_down, (void *)&keys[i]);
+            sim_at(SIM_SEC(t + hold / 1000), key_up, (void *)&keys[i]);
+            return;
+        }
+    }
+    usage();
+}
+
+static double uart_gap;
+
+static void schedule_uart(const char *spec) {
+    char text[64];
+    const char *colon = strchr(spec, ':');
+    double t;
+    unsigned int i;
+
+    if(!colon || strlen(colon + 1) > sizeof(text) - 2) usage();
+    snprintf(text, sizeof(text), "%s\r", colon + 1);
+    if(uart_gap <= 0) {
+        sim_uart_inject(SIM_SEC(atof(spec)), text);
+        return;
+    }
+    // 逐字符输入(模拟手动键入)
+    for(i = 0, t = atof(spec); text[i]; i++, t += uart_gap / 1000) {
+        char ch[2] = {text[i], 0};
+        sim_uart_inject(SIM_SEC(t), ch);
+    }
+}
+
+/* ---------- 掉电 ---------- */
+static double fail_at = -1, fail_holdup = 20;
+
+static void power_fail(void *) {
+    sim_power_fail();
+}
+
+static void schedule_fail(const char *spec) {
+    const char *plus = strchr(spec, '+');
+
+    fail_at = atof(spec);
+    if(plus) fail_holdup = atof(plus + 1);
+    sim_at(SIM_SEC(fail_at), power_fail, 0);
+}
+
+// 电压偏低期间每1ms重新置位标志，相当于低压检测电路持续输出；arg 为结束时刻
+static void power_sag(void *arg) {
+    uint64_t *end = (uint64_t *)arg;
+
+    sim_power_fail();
+    if(sim_cycles + SIM_SEC(0.001) < *end) {
+        sim_at(sim_cycles + SIM_SEC(0.001), power_sag, arg);
+    }
+}
+
+static void schedule_sag(const char *spec) {
+    const char *plus = strchr(spec, '+');
+    uint64_t *end;
+
+    if(!plus) usage();
+    end = new uint64_t(SIM_SEC(atof(spec) + atof(plus + 1)));
+    sim_at(SIM_SEC(atof(spec)), power_sag, end);
+}
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    double seconds = 0, wall;
+    const char *eeprom_file = 0;
+    long expect_auto = -1, expect_manual = -1;
+    char disp[9];
+    uint64_t days, rem;
+    unsigned int i, hot = 0;
+    FILE *f;
+    int opt, rc = 0;
+
+    sim_reset();
+    memset(sim_eeprom, 0xFF, sizeof(sim_eeprom));   // 出厂擦除状态
+
+    while((opt = getopt(argc, argv, "d:s:wvr:g:k:e:t:p:f:l:a:m:h")) != -1) {
+        switch(opt) {
+        case 'd': seconds += atof(optarg) * 86400; break;
+        case 's': seconds += atof(optarg); break;
+        case 'w': warp = true; break;
+        case 'v': uart_echo = true; break;
+        case 'r': schedule_uart(optarg); break;
+        case 'g': uart_gap = atof(optarg); break;
+        case 'k': schedule_key(optarg); break;
+        case 'e': eeprom_file = optarg; break;
+        case 't': sim_eeprom_twr = SIM_SEC(atof(optarg) / 1000); break;
+        case 'p': sim_flow_sensor(atof(optarg)); break;
+        case 'f': schedule_fail(optarg); break;
+        case 'l': schedule_sag(optarg); break;
+        case 'a': expect_auto = atol(optarg); break;
+        case 'm': expect_manual = atol(optarg); break;
+        default: usage();
+        }
+    }
+    if(seconds <= 0) usage();
+    if(fail_at >= 0 && fail_at + fail_holdup / 1000 < seconds) {
+        seconds = fail_at + fail_holdup / 1000;    // 储能电容放完，仿真到此为止
+    }
+
+    if(eeprom_file && (f = fopen(eeprom_file, "rb")) != 0) {
+        if(fread(sim_eeprom, 1, sizeof(sim_eeprom), f) != sizeof(sim_eeprom)) {
+            fprintf(stderr, "fws51: short eeprom image %s\n", eeprom_file);
+        }
+        fclose(f);
+    }
+
+    sim_vector[SIM_VEC_INT0] = INT0_ISR;
+    sim_vector[SIM_VEC_T2] = T2_ISR;
+    sim_vector[SIM_VEC_T0] = T0_ISR;
+    sim_vector[SIM_VEC_UART] = UART_ISR;
+    sim_vector[SIM_VEC_PCA] = PCA_isr;
+    sim_vector[SIM_VEC_LVD] = LVD_ISR;
+    sim_vector[SIM_VEC_INT1] = INT1_ISR;
+    sim_delay_hook = warp_delay;
+    sim_idle_hook = warp_idle;
+    sim_uart_tx_hook = uart_tx;
+    sim_stop_at(SIM_SEC(seconds));
+
+    wall = wall_seconds();
+    try {
+        fw_main();
+    } catch(sim_stop &) {
+    }
+    wall = wall_seconds() - wall;
+    sim_finish();
+
+    if(eeprom_file && (f = fopen(eeprom_file, "wb")) != 0) {
+        fwrite(sim_eeprom, 1, sizeof(sim_eeprom), f);
+        fclose(f);
+    }
+
+    for(i = 1; i < SIM_EEPROM_SIZE; i++) {
+        if(sim_eeprom_wear[i] > sim_eeprom_wear[hot]) hot = i;
+    }
+    days = sim_cycles / SIM_MCPS / 86400;
+    rem = sim_cycles / SIM_MCPS % 86400;
+    sim_display_text(disp);
+
+    if(uart_echo) fputc('\n', stdout);
+    printf("virtual time : %llud %02llu:%02llu:%02llu (%.3f s wall, x%.0f, %lu warp steps)\n",
+           (unsigned long long)days, (unsigned long long)(rem / 3600),
+           (unsigned long long)(rem / 60 % 60), (unsigned long long)(rem % 60),
+           wall, sim_cycles / (double)SIM_MCPS / (wall > 0 ? wall : 1e-9), warp_steps);
+    printf("rtc          : %04u-%02u-%02u %02u:%02u:%02u\n",
+           SysPara1.year, SysPara1.month, SysPara1.day,
+           SysPara1.hour, SysPara1.min, SysPara1.sec);
+    printf("display      : [%s]\n", disp);
+    printf("records      : auto %lu, manual %lu\n", auto_records, manual_records);
+    printf("relay        : %llu switches, %.1f s open valve\n",
+           (unsigned long long)sim_stat.relay_switches, sim_stat.relay_on_cycles / (double)SIM_MCPS);
+    printf("int0         : %llu edges, %llu isr\n",
+           (unsigned long long)sim_stat.int0_edges,
+           (unsigned long long)sim_stat.isr_count[SIM_VEC_INT0]);
+    printf("t2           : %llu counts, %llu isr, %llu masked, %llu false\n",
+           (unsigned long long)sim_stat.t2_counts,
+           (unsigned long long)sim_stat.isr_count[SIM_VEC_T2],
+           (unsigned long long)sim_stat.t2_masked,
+           (unsigned long long)sim_stat.t2_false);
+    printf("isr          : pca %llu, t0 %llu, uart %llu (%.2f%% cpu)\n",
+           (unsigned long long)sim_stat.isr_count[SIM_VEC_PCA],
+           (unsigned long long)sim_stat.isr_count[SIM_VEC_T0],
+           (unsigned long long)sim_stat.isr_count[SIM_VEC_UART],
+           sim_cycles ? 100.0 * sim_isr_cycles / sim_cycles : 0.0);
+    printf("idle         : %.2f%% of time in PCON.IDL\n",
+           sim_cycles ? 100.0 * sim_stat.idle_cycles / sim_cycles : 0.0);
+    printf("uart         : %llu tx bytes, %llu tx overruns, %llu rx overruns\n",
+           (unsigned long long)sim_stat.uart_tx_bytes,
+           (unsigned long long)sim_stat.uart_tx_overruns,
+           (unsigned long long)sim_stat.uart_rx_overruns);
+    printf("eeprom       : %llu write cycles, %llu busy nacks, hottest 0x%02X x%u\n",
+           (unsigned long long)sim_stat.eeprom_write_cycles,
+           (unsigned long long)sim_stat.eeprom_nacks, hot, sim_eeprom_wear[hot]);
+
+    if(expect_auto >= 0 && (unsigned long)expect_auto != auto_records) {
+        fprintf(stderr, "fws51: expected %ld auto records, got %lu\n", expect_auto, auto_records);
+        rc = 1;
+    }
+    if(expect_manual >= 0 && (unsigned long)expect_manual != manual_records) {
+        fprintf(stderr, "fws51: expected %ld manual records, got %lu\n", expect_manual, manual_records);
+        rc = 1;
+    }
+    if(sim_stat.t2_masked || sim_stat.t2_false) {
+        fprintf(stderr, "fws51: P1.0 latch driven low while used as T2 input\n");
+        rc = 1;
+    }
+    return rc;
+}
@@ -0,0 +1,23 @@
+/*--------------------------------------------------------------------------
+INTRINS.H
+
+主机仿真用的 Keil INTRINS.H 替身：_nop_() 消耗一个机器周期。
+--------------------------------------------------------------------------*/
+
+#ifndef __INTRINS_H__
+#define __INTRINS_H__
+
+#include "sim51.h"
+
+static inline void _nop_(void) { sim_cycle(); sim_irq_poll(); }
+
+static inline bool _testbit_(bool &b) { bool v = b; b = 0; return v; }
+
+static inline unsigned char _crol_(unsigned char v, unsigned char n) { n &= 7; return (unsigned char)((v << n) | (v >> ((8 - n) & 7))); }
+static inline unsigned char _cror_(unsigned char v, unsigned char n) { n &= 7; return (unsigned char)((v >> n) | (v << ((8 - n) & 7))); }
+static inline unsigned int  _irol_(unsigned int v, unsigned char n)  { n &= 15; v &= 0xFFFF; return (v << n | v >> ((16 - n) & 15)) & 0xFFFF; }
+static inline unsigned int  _iror_(unsigned int v, unsigned char n)  { n &= 15; v &= 0xFFFF; return (v >> n | v << ((16 - n) & 15)) & 0xFFFF; }
+static inline unsigned long _lrol_(unsigned long v, unsigned char n) { n &= 31; v &= 0xFFFFFFFFUL; return (v << n | v >> ((32 - n) & 31)) & 0xFFFFFFFFUL; }
+static inline unsigned long _lror_(unsigned long v, unsigned char n) { n &= 31; v &= 0xFFFFFFFFUL; return (v >> n | v << ((32 - n) & 31)) & 0xFFFFFFFFUL; }
+
+#endif
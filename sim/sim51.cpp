@@ -0,0 +1,806 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <utility>
+#include "sim51.h"
+
+/*
+ * ========================================
+ * 8051 外设模型
+ * ========================================
+ *
+ * 与固件硬件连接一致：
+ * - P1.0 方波输出，经继电器(P1.1 低电平吸合)接到 P3.2/INT0
+ * - P1.2~P1.7、P3.3 按键(外部拉低)
+ * - P2.0~P2.3 74HC595 数码管(DATA/SCK/RCK/OE)
+ * - P2.5/P2.6 I2C 总线上的 AT24C02
+ * - PCA 模块0/1 16位软件定时器，T0 模式1，T1 作波特率发生器
+ * - T2 计数器模式(16位自动重装)，对外部流量传感器脉冲计数
+ */
+
+#define NEVER UINT64_MAX
+
+// SFR 地址
+#define SFR_P0      0x80
+#define SFR_PCON    0x87
+#define SFR_TCON    0x88
+#define SFR_TMOD    0x89
+#define SFR_TL0     0x8A
+#define SFR_TL1     0x8B
+#define SFR_TH0     0x8C
+#define SFR_TH1     0x8D
+#define SFR_P1      0x90
+#define SFR_SCON    0x98
+#define SFR_SBUF    0x99
+#define SFR_P2      0xA0
+#define SFR_IE      0xA8
+#define SFR_P3      0xB0
+#define SFR_T2CON   0xC8
+#define SFR_RCAP2L  0xCA
+#define SFR_RCAP2H  0xCB
+#define SFR_TL2     0xCC
+#define SFR_TH2     0xCD
+#define SFR_CCON    0xD8
+#define SFR_CMOD    0xD9
+#define SFR_CCAPM0  0xDA
+#define SFR_CCAPM1  0xDB
+#define SFR_CL      0xE9
+#define SFR_CCAP0L  0xEA
+#define SFR_CCAP1L  0xEB
+#define SFR_CH      0xF9
+#define SFR_CCAP0H  0xFA
+#define SFR_CCAP1H  0xFB
+
+uint64_t sim_cycles;
+uint64_t sim_next_event;
+uint64_t sim_isr_cycles;
+bool sim_irq_check;
+bool sim_in_isr;
+
+sim_isr_t sim_vector[SIM_VEC_NUM];
+bool (*sim_delay_hook)(unsigned int ms);
+bool (*sim_idle_hook)(void);
+void (*sim_uart_tx_hook)(unsigned char ch);
+sim_stats sim_stat;
+
+unsigned char sim_eeprom[SIM_EEPROM_SIZE];
+uint32_t sim_eeprom_wear[SIM_EEPROM_SIZE];
+uint64_t sim_eeprom_twr = SIM_MCPS * 5 / 1000;   // 24C02 典型写周期 5ms
+unsigned char sim_display[8];
+
+static unsigned char sfr_mem[256];        // 寄存器与端口锁存器
+static unsigned char ext_pin[4];          // 外部驱动(按位与)
+static uint64_t stop_at;
+static std::multimap<uint64_t, std::pair<sim_event_t, void *> > timers;
+
+static uint64_t delay_frac;               // 毫秒换算的小数部分(1/1000周期)
+
+/* ---------- 定时器0(模式1) ---------- */
+static bool t0_run;
+static uint64_t t0_base;
+static uint16_t t0_val;
+static uint64_t t0_ovf;
+
+static uint16_t t0_count(void) {
+    return t0_run ? (uint16_t)(t0_val + (sim_cycles - t0_base)) : t0_val;
+}
+
+static void t0_rebase(uint16_t v) {
+    t0_val = v;
+    t0_base = sim_cycles;
+    t0_ovf = t0_run ? sim_cycles + (0x10000 - v) : NEVER;
+}
+
+/* ---------- PCA ---------- */
+static const unsigned char ccapl[2] = {SFR_CCAP0L, SFR_CCAP1L};
+static const unsigned char ccaph[2] = {SFR_CCAP0H, SFR_CCAP1H};
+static const unsigned char ccapm[2] = {SFR_CCAPM0, SFR_CCAPM1};
+static uint64_t pca_base;
+static uint16_t pca_val;
+static uint64_t pca_next[2];
+static uint16_t pca_off[2];               // 快进时被冻结的模块比较偏移
+
+static bool pca_run(void) { return (sfr_mem[SFR_CCON] & 0x40) != 0; }
+
+static uint16_t pca_count(void) {
+    return pca_run() ? (uint16_t)(pca_val + (sim_cycles - pca_base)) : pca_val;
+}
+
+static void pca_schedule(void) {
+    unsigned char n;
+    uint16_t now = pca_count();
+    for(n = 0; n < 2; n++) {
+        // ECOM + MAT：16位软件定时器匹配
+        if(pca_run() && (sfr_mem[ccapm[n]] & 0x48) == 0x48) {
+            uint16_t target = sfr_mem[ccapl[n]] | (sfr_mem[ccaph[n]] << 8);
+            uint32_t delta = (uint16_t)(target - (uint16_t)(now - pca_off[n]));
+            pca_next[n] = sim_cycles + (delta ? delta : 0x10000);
+        } else {
+            pca_next[n] = NEVER;
+        }
+    }
+}
+
+static void pca_rebase(uint16_t v) {
+    pca_val = v;
+    pca_base = sim_cycles;
+    pca_schedule();
+}
+
+/* ---------- UART ---------- */
+static uint64_t tx_done;
+static unsigned char tx_byte;
+static unsigned char rx_sbuf;
+static std::multimap<uint64_t, unsigned char> rx_queue;
+
+static uint64_t uart_byte_cycles(void) {
+    unsigned char th1 = sfr_mem[SFR_TH1] ? sfr_mem[SFR_TH1] : 0xFD;
+    uint64_t bit = 32 * (256 - th1);
+    if(sfr_mem[SFR_PCON] & 0x80) bit /= 2;
+    return bit * 10;                       // 起始位 + 8数据位 + 停止位
+}
+
+/* ---------- 引脚与 INT0/INT1 ---------- */
+static bool int0_level = 1;
+static bool int1_level = 1;
+static uint64_t relay_since;
+
+bool sim_relay_closed(void) {
+    return (sfr_mem[SFR_P1] & 0x02) == 0;
+}
+
+static unsigned char pin_p1(void) {
+    return sfr_mem[SFR_P1] & ext_pin[1];
+}
+
+/* 外部流量传感器：继电器吸合期间以固定频率输出脉冲，取代 P1.0 方波 */
+static uint64_t sensor_half;            // 半周期(机器周期)，0=未接入
+static uint64_t sensor_next = NEVER;
+static bool sensor_level = 1;
+
+static unsigned char pin_p3(void) {
+    unsigned char v = sfr_mem[SFR_P3] & ext_pin[3];
+    if(sensor_half) {
+        if(!sensor_level) v &= ~0x04;
+    } else if(sim_relay_closed() && !(pin_p1() & 0x01)) {
+        v &= ~0x04;                     // 继电器吸合时 P1.0 方波接入 P3.2
+    }
+    return v;
+}
+
+/* 定时器2计数器模式：外部流量传感器同时接到 T2(P1.0) 引脚，引脚电平为
+ * 传感器与 P1.0 锁存器的线与，锁存器为0时传感器的边沿看不到 */
+static void t2_edge(void) {
+    uint16_t c;
+    // TR2 且 C/T2=1
+    if((sfr_mem[SFR_T2CON] & 0x06) != 0x06) return;
+    if(!(sfr_mem[SFR_P1] & 0x01)) {
+        sim_stat.t2_masked++;
+        return;
+    }
+    sim_stat.t2_counts++;
+    c = (sfr_mem[SFR_TL2] | (sfr_mem[SFR_TH2] << 8)) + 1;
+    if(c == 0) {
+        sfr_mem[SFR_T2CON] |= 0x80;                 // TF2
+        c = sfr_mem[SFR_RCAP2L] | (sfr_mem[SFR_RCAP2H] << 8);
+        sim_irq_check = true;
+    }
+    sfr_mem[SFR_TL2] = c & 0xFF;
+    sfr_mem[SFR_TH2] = c >> 8;
+}
+
+static void sensor_update(void) {
+    if(!sensor_half) return;
+    if(sim_relay_closed()) {
+        if(sensor_next == NEVER) sensor_next = sim_cycles + sensor_half;
+    } else {
+        sensor_next = NEVER;
+        sensor_level = 1;
+    }
+}
+
+static void ext_int_update(void) {
+    unsigned char p3 = pin_p3();
+    bool l0 = (p3 & 0x04) != 0;
+    bool l1 = (p3 & 0x08) != 0;
+    unsigned char tcon = sfr_mem[SFR_TCON];
+
+    if(l0 != int0_level) {
+        if(!l0) sim_stat.int0_edges++;
+        if(!l0 && (tcon & 0x01)) tcon |= 0x02;      // IT0=1 下降沿触发
+        int0_level = l0;
+    }
+    if(!(tcon & 0x01)) tcon = l0 ? (tcon & ~0x02) : (tcon | 0x02);
+
+    if(l1 != int1_level) {
+        if(!l1 && (tcon & 0x04)) tcon |= 0x08;
+        int1_level = l1;
+    }
+    if(!(tcon & 0x04)) tcon = l1 ? (tcon & ~0x08) : (tcon | 0x08);
+
+    if(tcon != sfr_mem[SFR_TCON]) {
+        sfr_mem[SFR_TCON] = tcon;
+        sim_irq_check = true;
+    }
+}
+
+/* ---------- AT24C02 ---------- */
+enum { EE_IDLE, EE_DEV, EE_WORD, EE_WDATA, EE_RDATA };
+static int ee_state;
+static unsigned char ee_bits;
+static unsigned char ee_shift;
+static bool ee_drive = 1;               // 从机对 SDA 的驱动(0=拉低)
+static bool ee_ack_phase;               // 第9个时钟由从机应答
+static bool ee_mack_phase;              // 第9个时钟由主机应答(读)
+static bool ee_mack;
+static unsigned char ee_addr;
+static unsigned char ee_page[8];
+static unsigned char ee_page_dirty;
+static unsigned char ee_page_base;
+static uint64_t ee_busy_until;
+static bool i2c_scl = 1, i2c_sda = 1;
+
+static void ee_start(void) {
+    ee_state = EE_DEV;
+    ee_bits = 0;
+    ee_shift = 0;
+    ee_drive = 1;
+    ee_ack_phase = 0;
+    ee_mack_phase = 0;
+    ee_page_dirty = 0;                  // 未以停止信号结束的写入被丢弃
+}
+
+static void ee_stop(void) {
+    unsigned char i;
+    if(ee_page_dirty) {
+        for(i = 0; i < 8; i++) {
+            if(ee_page_dirty & (1 << i)) {
+                sim_eeprom[ee_page_base + i] = ee_page[i];
+                sim_eeprom_wear[ee_page_base + i]++;
+            }
+        }
+        ee_page_dirty = 0;
+        sim_stat.eeprom_write_cycles++;
+        ee_busy_until = sim_cycles + sim_eeprom_twr;
+    }
+    ee_state = EE_IDLE;
+    ee_drive = 1;
+}
+
+static void ee_load(void) {
+    ee_shift = sim_eeprom[ee_addr];
+    ee_bits = 0;
+    ee_drive = (ee_shift & 0x80) != 0;
+}
+
+static void ee_rise(bool sda) {
+    if(ee_state == EE_IDLE || ee_ack_phase) return;
+    if(ee_mack_phase) {
+        ee_mack = sda;
+    } else if(ee_state != EE_RDATA) {
+        ee_shift = (ee_shift << 1) | sda;
+        ee_bits++;
+    }
+}
+
+static void ee_fall(void) {
+    if(ee_state == EE_IDLE) return;
+
+    if(ee_ack_phase) {
+        ee_ack_phase = 0;
+        ee_drive = 1;
+        if(ee_state == EE_RDATA) ee_load();
+        else ee_bits = 0;
+        return;
+    }
+    if(ee_mack_phase) {
+        ee_mack_phase = 0;
+        if(ee_mack) {                       // 主机非应答，读结束
+            ee_state = EE_IDLE;
+            ee_drive = 1;
+        } else {
+            ee_load();
+        }
+        return;
+    }
+    if(ee_state == EE_RDATA) {
+        if(++ee_bits < 8) {
+            ee_drive = (ee_shift >> (7 - ee_bits)) & 1;
+        } else {
+            ee_drive = 1;
+            ee_mack_phase = 1;
+            ee_addr++;
+        }
+        return;
+    }
+    if(ee_bits < 8) return;
+
+    switch(ee_state) {
+    case EE_DEV:
+        if((ee_shift & 0xFE) != 0xA0 || sim_cycles < ee_busy_until) {
+            if(sim_cycles < ee_busy_until) sim_stat.eeprom_nacks++;
+            ee_state = EE_IDLE;             // 不应答，等待停止信号
+            return;
+        }
+        ee_state = (ee_shift & 0x01) ? EE_RDATA : EE_WORD;
+        break;
+    case EE_WORD:
+        ee_addr = ee_shift;
+        ee_page_base = ee_shift & 0xF8;
+        ee_state = EE_WDATA;
+        break;
+    case EE_WDATA:
+        // 页内地址回卷(8字节页)
+        ee_page[ee_addr & 7] = ee_shift;
+        ee_page_dirty |= 1 << (ee_addr & 7);
+        ee_addr = (ee_addr & 0xF8) | ((ee_addr + 1) & 7);
+        break;
+    }
+    ee_drive = 0;
+    ee_ack_phase = 1;
+}
+
+static void i2c_update(void) {
+    bool scl = (sfr_mem[SFR_P2] & 0x40) != 0;
+    bool sda = (sfr_mem[SFR_P2] & 0x20) && ee_drive;
+
+    if(scl == i2c_scl && sda == i2c_sda) return;
+    if(scl && i2c_scl) {
+        if(!sda) ee_start();
+        else ee_stop();
+    } else if(scl) {
+        ee_rise(sda);
+    } else if(i2c_scl) {
+        ee_fall();
+    }
+    i2c_scl = scl;
+    i2c_sda = (sfr_mem[SFR_P2] & 0x20) && ee_drive;
+}
+
+/* ---------- 74HC595 数码管 ---------- */
+static uint16_t hc_shift;
+
+static void hc595_update(unsigned char old, unsigned char val) {
+    unsigned char i, sel, seg;
+    if((val & 0x02) && !(old & 0x02)) {     // SCK 上升沿移位
+        hc_shift = (hc_shift << 1) | (val & 0x01);
+    }
+    if((val & 0x04) && !(old & 0x04)) {     // RCK 上升沿锁存
+        sel = hc_shift >> 8;                // 先移入的是位选
+        seg = hc_shift & 0xFF;
+        for(i = 0; i < 8; i++) {
+            if(!(sel & (1 << i))) sim_display[i] = seg;
+        }
+        sim_stat.display_frames++;
+    }
+}
+
+void sim_display_text(char *out) {
+    static const struct { unsigned char seg; char ch; } font[] = {
+        {0x3F, '0'}, {0x06, '1'}, {0x5B, '2'}, {0x4F, '3'}, {0x66, '4'},
+        {0x6D, '5'}, {0x7D, '6'}, {0x07, '7'}, {0x7F, '8'}, {0x6F, '9'},
+        {0x39, 'C'}, {0x71, 'F'}, {0x5F, 'd'}, {0x77, 'A'}, {0x7C, 'b'},
+        {0x58, 'c'}, {0x40, '-'}, {0x00, ' '},
+    };
+    int i, k;
+    for(i = 0; i < 8; i++) {
+        out[i] = '?';
+        for(k = 0; k < (int)(sizeof(font) / sizeof(font[0])); k++) {
+            if(font[k].seg == (sim_display[7 - i] & 0x7F)) out[i] = font[k].ch;   // 忽略小数点
+        }
+    }
+    out[8] = 0;
+}
+
+/* ---------- 事件调度 ---------- */
+enum { EV_NONE, EV_T0, EV_PCA0, EV_PCA1, EV_TX, EV_RX, EV_SENSOR, EV_TIMER, EV_STOP };
+
+static int earliest(uint64_t *when) {
+    int ev = EV_NONE;
+    uint64_t t = NEVER;
+    if(t0_ovf < t) { t = t0_ovf; ev = EV_T0; }
+    if(pca_next[0] < t) { t = pca_next[0]; ev = EV_PCA0; }
+    if(pca_next[1] < t) { t = pca_next[1]; ev = EV_PCA1; }
+    if(tx_done < t) { t = tx_done; ev = EV_TX; }
+    if(!rx_queue.empty() && rx_queue.begin()->first < t) { t = rx_queue.begin()->first; ev = EV_RX; }
+    if(sensor_next < t) { t = sensor_next; ev = EV_SENSOR; }
+    if(!timers.empty() && timers.begin()->first < t) { t = timers.begin()->first; ev = EV_TIMER; }
+    if(stop_at < t) { t = stop_at; ev = EV_STOP; }
+    *when = t;
+    return ev;
+}
+
+void sim_process_events(void) {
+    uint64_t t;
+    int ev;
+
+    while((ev = earliest(&t)) != EV_NONE && t <= sim_cycles) {
+        switch(ev) {
+        case EV_T0:
+            sfr_mem[SFR_TCON] |= 0x20;              // TF0
+            t0_val = 0;
+            t0_base = t;
+            t0_ovf = t + 0x10000;
+            sim_irq_check = true;
+            break;
+        case EV_PCA0:
+        case EV_PCA1: {
+            unsigned char n = ev - EV_PCA0;
+            sfr_mem[SFR_CCON] |= 1 << n;            // CCFn
+            pca_next[n] = t + 0x10000;
+            sim_irq_check = true;
+            break;
+        }
+        case EV_TX:
+            sfr_mem[SFR_SCON] |= 0x02;              // TI
+            tx_done = NEVER;
+            sim_stat.uart_tx_bytes++;
+            if(sim_uart_tx_hook) sim_uart_tx_hook(tx_byte);
+            sim_irq_check = true;
+            break;
+        case EV_RX: {
+            unsigned char ch = rx_queue.begin()->second;
+            rx_queue.erase(rx_queue.begin());
+            if(sfr_mem[SFR_SCON] & 0x10) {          // REN
+                if(sfr_mem[SFR_SCON] & 0x01) {
+                    sim_stat.uart_rx_overruns++;    // RI 未清除，丢弃
+                } else {
+                    rx_sbuf = ch;
+                    sfr_mem[SFR_SCON] |= 0x01;      // RI
+                    sim_irq_check = true;
+                }
+            }
+            break;
+        }
+        case EV_SENSOR:
+            sensor_level = !sensor_level;
+            sensor_next = t + sensor_half;
+            if(!sensor_level) t2_edge();           // 锁存器为0时被吞掉
+            ext_int_update();
+            break;
+        case EV_TIMER: {
+            std::pair<sim_event_t, void *> cb = timers.begin()->second;
+            timers.erase(timers.begin());
+            cb.first(cb.second);
+            break;
+        }
+        case EV_STOP:
+            stop_at = NEVER;
+            throw sim_stop();
+        }
+    }
+    earliest(&sim_next_event);
+}
+
+static void reschedule(void) {
+    earliest(&sim_next_event);
+    if(sim_next_event <= sim_cycles) sim_process_events();
+}
+
+void sim_dispatch(void) {
+    unsigned char ie, v;
+    uint64_t start;
+
+    // RETI 之后至少执行一条主程序指令才响应下一个中断，
+    // 因此每次只分发一个，其余留给下一次 SFR 访问
+    sim_irq_check = false;
+    {
+        ie = sfr_mem[SFR_IE];
+        if(!(ie & 0x80)) return;
+
+        // 按 8051 硬件查询顺序响应(固件未设置 IP，不考虑嵌套)
+        if((ie & 0x01) && (sfr_mem[SFR_TCON] & 0x02)) {
+            v = SIM_VEC_INT0;
+            if(sfr_mem[SFR_TCON] & 0x01) sfr_mem[SFR_TCON] &= ~0x02;
+        } else if((ie & 0x02) && (sfr_mem[SFR_TCON] & 0x20)) {
+            v = SIM_VEC_T0;
+            sfr_mem[SFR_TCON] &= ~0x20;
+        } else if((ie & 0x04) && (sfr_mem[SFR_TCON] & 0x08)) {
+            v = SIM_VEC_INT1;
+            if(sfr_mem[SFR_TCON] & 0x04) sfr_mem[SFR_TCON] &= ~0x08;
+        } else if((ie & 0x08) && (sfr_mem[SFR_TCON] & 0x80)) {
+            v = SIM_VEC_T1;
+            sfr_mem[SFR_TCON] &= ~0x80;
+        } else if((ie & 0x10) && (sfr_mem[SFR_SCON] & 0x03)) {
+            v = SIM_VEC_UART;
+        } else if((ie & 0x20) && (sfr_mem[SFR_T2CON] & 0xC0)) {
+            v = SIM_VEC_T2;                         // TF2/EXF2 由软件清除
+        } else if((ie & 0x40) && (sfr_mem[SFR_PCON] & 0x20)) {
+            v = SIM_VEC_LVD;                        // LVDF 由软件清除
+        } else if(((sfr_mem[SFR_CCON] & 0x01) && (sfr_mem[SFR_CCAPM0] & 0x01)) ||
+                  ((sfr_mem[SFR_CCON] & 0x02) && (sfr_mem[SFR_CCAPM1] & 0x01))) {
+            v = SIM_VEC_PCA;
+        } else {
+            return;
+        }
+
+        if(!sim_vector[v]) {
+            fprintf(stderr, "sim: interrupt %d has no handler\n", v);
+            exit(2);
+        }
+        start = sim_cycles;
+        sim_in_isr = true;
+        sim_cycles += 2;                            // LCALL
+        sim_vector[v]();
+        sim_cycles += 2;                            // RETI
+        sim_in_isr = false;
+        sim_isr_cycles += sim_cycles - start;
+        sim_stat.isr_count[v]++;
+        sim_irq_check = true;
+        if(sim_cycles >= sim_next_event) sim_process_events();
+    }
+}
+
+/* ---------- 空闲模式 ---------- */
+// PCON.IDL：CPU停止取指，外设继续运行，任一中断响应后从下一条指令继续
+static void cpu_idle(void) {
+    uint64_t isr0 = sim_isr_cycles;
+    uint64_t start = sim_cycles;
+
+    if(sim_in_isr) {
+        fprintf(stderr, "sim: PCON idle inside interrupt\n");
+        exit(2);
+    }
+    if(sim_idle_hook && sim_idle_hook()) {
+        sfr_mem[SFR_PCON] &= ~0x01;
+        return;
+    }
+    while(sim_isr_cycles == isr0) {
+        if(sim_next_event > sim_cycles) sim_cycles = sim_next_event;
+        sim_process_events();
+        sim_irq_poll();
+    }
+    sim_stat.idle_cycles += sim_cycles - start;
+    sfr_mem[SFR_PCON] &= ~0x01;
+}
+
+/* ---------- SFR 读写 ---------- */
+unsigned char sim_sfr_latch(unsigned char addr) {
+    return sfr_mem[addr];
+}
+
+unsigned char sim_sfr_read(unsigned char addr) {
+    switch(addr) {
+    case SFR_P0:   return sfr_mem[SFR_P0] & ext_pin[0];
+    case SFR_P1:   return pin_p1();
+    case SFR_P2:   return (sfr_mem[SFR_P2] & ext_pin[2]) & (ee_drive ? 0xFF : ~0x20);
+    case SFR_P3:   return pin_p3();
+    case SFR_SBUF: return rx_sbuf;
+    case SFR_TL0:  return t0_count() & 0xFF;
+    case SFR_TH0:  return t0_count() >> 8;
+    case SFR_CL:   return pca_count() & 0xFF;
+    case SFR_CH:   return pca_count() >> 8;
+    }
+    return sfr_mem[addr];
+}
+
+void sim_sfr_write(unsigned char addr, unsigned char val) {
+    unsigned char old = sfr_mem[addr];
+    sfr_mem[addr] = val;
+
+    switch(addr) {
+    case SFR_PCON:
+        if(val & 0x01) cpu_idle();
+        break;
+    case SFR_P1:
+        // 传感器为高时程序把 P1.0 拉低，T2 引脚出现一个假下降沿
+        if(sensor_half && sensor_level && (old & 0x01) && !(val & 0x01)) {
+            uint64_t counted = sim_stat.t2_counts;
+            sfr_mem[SFR_P1] = old;
+            t2_edge();
+            sfr_mem[SFR_P1] = val;
+            if(sim_stat.t2_counts != counted) sim_stat.t2_false++;
+        }
+        if((old ^ val) & 0x02) {
+            if(!(val & 0x02)) {
+                relay_since = sim_cycles;
+                sim_stat.relay_switches++;
+            } else {
+                sim_stat.relay_on_cycles += sim_cycles - relay_since;
+            }
+            sensor_update();
+        }
+        ext_int_update();
+        reschedule();
+        break;
+    case SFR_P2:
+        if((old ^ val) & 0x0F) hc595_update(old, val);
+        if((old ^ val) & 0x60) i2c_update();
+        break;
+    case SFR_P3:
+        ext_int_update();
+        break;
+    case SFR_TCON:
+        if((old ^ val) & 0x10) {                    // TR0
+            uint16_t c = t0_count();
+            t0_run = (val & 0x10) != 0;
+            t0_rebase(c);
+        }
+        ext_int_update();
+        sim_irq_check = true;
+        reschedule();
+        break;
+    case SFR_TL0:
+        t0_rebase((t0_count() & 0xFF00) | val);
+        reschedule();
+        break;
+    case SFR_TH0:
+        t0_rebase((t0_count() & 0x00FF) | (val << 8));
+        reschedule();
+        break;
+    case SFR_SBUF:
+        sfr_mem[SFR_SBUF] = old;
+        if(tx_done != NEVER) sim_stat.uart_tx_overruns++;
+        tx_byte = val;
+        tx_done = sim_cycles + uart_byte_cycles();
+        reschedule();
+        break;
+    case SFR_SCON:
+    case SFR_IE:
+    case SFR_T2CON:
+        sim_irq_check = true;
+        break;
+    case SFR_CCON:
+        sfr_mem[SFR_CCON] = old;
+        if((old ^ val) & 0x40) {                    // CR
+            uint16_t c = pca_count();
+            sfr_mem[SFR_CCON] = val;
+            pca_rebase(c);
+        }
+        sfr_mem[SFR_CCON] = val;
+        sim_irq_check = true;
+        reschedule();
+        break;
+    case SFR_CL:
+        pca_rebase((pca_count() & 0xFF00) | val);
+        reschedule();
+        break;
+    case SFR_CH:
+        pca_rebase((pca_count() & 0x00FF) | (val << 8));
+        reschedule();
+        break;
+    case SFR_CCAPM0:
+    case SFR_CCAPM1:
+    case SFR_CCAP0L:
+    case SFR_CCAP0H:
+    case SFR_CCAP1L:
+    case SFR_CCAP1H:
+        pca_schedule();
+        sim_irq_check = true;
+        reschedule();
+        break;
+    }
+}
+
+/* ---------- 仿真控制 ---------- */
+void sim_reset(void) {
+    memset(sfr_mem, 0, sizeof(sfr_mem));
+    sfr_mem[SFR_P0] = sfr_mem[SFR_P1] = sfr_mem[SFR_P2] = sfr_mem[SFR_P3] = 0xFF;
+    sfr_mem[0x81] = 0x07;                           // SP
+    memset(ext_pin, 0xFF, sizeof(ext_pin));
+    memset(&sim_stat, 0, sizeof(sim_stat));
+    memset(sim_display, 0, sizeof(sim_display));
+    sim_cycles = 0;
+    sim_isr_cycles = 0;
+    sim_irq_check = false;
+    sim_in_isr = false;
+    stop_at = NEVER;
+    timers.clear();
+    rx_queue.clear();
+    t0_run = false;
+    t0_rebase(0);
+    pca_off[0] = pca_off[1] = 0;
+    pca_rebase(0);
+    tx_done = NEVER;
+    int0_level = int1_level = 1;
+    ee_state = EE_IDLE;
+    ee_drive = 1;
+    ee_busy_until = 0;
+    i2c_scl = i2c_sda = 1;
+    delay_frac = 0;
+    earliest(&sim_next_event);
+}
+
+void sim_advance(uint64_t n) {
+    uint64_t isr0 = sim_isr_cycles;
+    uint64_t target = sim_cycles + n;
+    uint64_t end;
+
+    // 延时循环被中断打断时，中断执行时间不计入延时
+    while(sim_cycles < (end = target + (sim_isr_cycles - isr0))) {
+        if(sim_next_event <= end) {
+            if(sim_next_event > sim_cycles) sim_cycles = sim_next_event;
+            sim_process_events();
+        } else {
+            sim_cycles = end;
+        }
+        sim_irq_poll();
+    }
+}
+
+void sim_delay_ms(unsigned int ms) {
+    uint64_t n;
+    if(sim_delay_hook && sim_delay_hook(ms)) return;
+    n = (uint64_t)ms * SIM_MCPS + delay_frac;
+    delay_frac = n % 1000;
+    sim_advance(n / 1000);
+}
+
+void sim_at(uint64_t when, sim_event_t fn, void *arg) {
+    timers.insert(std::make_pair(when, std::make_pair(fn, arg)));
+    reschedule();
+}
+
+uint64_t sim_next_scheduled(void) {
+    uint64_t t = timers.empty() ? NEVER : timers.begin()->first;
+    if(!rx_queue.empty() && rx_queue.begin()->first < t) t = rx_queue.begin()->first;
+    return t;
+}
+
+void sim_power_fail(void) {
+    sfr_mem[SFR_PCON] |= 0x20;
+    sim_irq_check = true;
+}
+
+void sim_stop_at(uint64_t when) {
+    stop_at = when;
+    reschedule();
+}
+
+void sim_pin_drive(unsigned char port, unsigned char bit, bool level) {
+    if(level) ext_pin[port & 3] |= 1 << bit;
+    else ext_pin[port & 3] &= ~(1 << bit);
+    ext_int_update();
+}
+
+void sim_uart_inject(uint64_t when, const char *text) {
+    uint64_t step = uart_byte_cycles();
+    while(*text) {
+        when += step;
+        rx_queue.insert(std::make_pair(when, (unsigned char)*text++));
+    }
+    reschedule();
+}
+
+bool sim_uart_busy(void) {
+    return tx_done != NEVER || (sfr_mem[SFR_SCON] & 0x03);
+}
+
+void sim_pca_skip(uint64_t n, unsigned char frozen) {
+    unsigned char i;
+    if((frozen & 0x03) == 0x03) {
+        pca_base += n;                      // 计数器整体冻结
+    } else {
+        for(i = 0; i < 2; i++) {
+            if(frozen & (1 << i)) pca_off[i] += (uint16_t)n;
+        }
+    }
+    for(i = 0; i < 2; i++) {
+        if(pca_next[i] != NEVER && (frozen & (1 << i))) pca_next[i] += n;
+    }
+    sim_cycles += n;
+    reschedule();
+    sim_irq_poll();
+}
+
+void sim_flow_sensor(double hz) {
+    sensor_half = hz > 0 ? SIM_SEC(0.5 / hz) : 0;
+    if(sensor_half == 0 && hz > 0) sensor_half = 1;
+    sensor_next = NEVER;
+    sensor_level = 1;
+    sensor_update();
+    ext_int_update();
+    reschedule();
+}
+
+uint64_t sim_pca_next_match(unsigned char module) {
+    return pca_next[module & 1];
+}
+
+void sim_finish(void) {
+    if(sim_relay_closed()) {
+        sim_stat.relay_on_cycles += sim_cycles - relay_since;
+        relay_since = sim_cycles;
+    }
+}
@@ -0,0 +1,176 @@
+#ifndef __SIM51_H__
+#define __SIM51_H__
+
+/*
+ * ========================================
+ * 主机端 8051 虚拟时间仿真内核
+ * ========================================
+ *
+ * 固件源码以 C++ 方式编译，sfr/sbit 被映射为下面的代理对象：
+ * - 每次 SFR 访问消耗 1 个机器周期，并推进虚拟时钟
+ * - 外设(PCA/T0/UART/INT0/24C02/74HC595)以事件方式建模，
+ *   时钟直接跳到下一个事件，不做空转
+ * - 中断在 SFR 访问结束后分发(与真实 8051 “当前指令执行完再响应”一致)
+ *
+ * 时间单位：机器周期 = FOSC/12 = 921600 Hz
+ */
+
+#include <stdint.h>
+
+#define SIM_FOSC        11059200UL
+#define SIM_MCPS        (SIM_FOSC / 12)        // 每秒机器周期数
+#define SIM_SEC(s)      ((uint64_t)((s) * (double)SIM_MCPS))
+
+// 中断向量号(与 Keil "interrupt N" 相同)
+#define SIM_VEC_INT0    0
+#define SIM_VEC_T0      1
+#define SIM_VEC_INT1    2
+#define SIM_VEC_T1      3
+#define SIM_VEC_UART    4
+#define SIM_VEC_T2      5
+#define SIM_VEC_LVD     6                    // STC89C5xRC 低压检测
+#define SIM_VEC_PCA     7
+#define SIM_VEC_NUM     8
+
+// 仿真结束时抛出，由主机端 main 捕获
+struct sim_stop {};
+
+/* ---------- 虚拟时钟 ---------- */
+extern uint64_t sim_cycles;          // 上电以来的机器周期
+extern uint64_t sim_next_event;      // 下一个外设事件的时间
+extern uint64_t sim_isr_cycles;      // 中断服务程序累计消耗的周期
+extern bool sim_irq_check;           // 可能有中断待响应
+extern bool sim_in_isr;              // 正在执行中断服务程序
+
+void sim_process_events(void);
+void sim_dispatch(void);
+
+static inline void sim_cycle(void) {
+    if(++sim_cycles >= sim_next_event) sim_process_events();
+}
+
+static inline void sim_irq_poll(void) {
+    if(sim_irq_check && !sim_in_isr) sim_dispatch();
+}
+
+/* ---------- SFR 访问 ---------- */
+unsigned char sim_sfr_read(unsigned char addr);    // 读引脚/寄存器
+unsigned char sim_sfr_latch(unsigned char addr);   // 读锁存器(读-改-写指令)
+void sim_sfr_write(unsigned char addr, unsigned char val);
+
+struct sim_sbit {
+    unsigned char addr;
+    unsigned char mask;
+    constexpr sim_sbit(unsigned char a, unsigned char b) : addr(a), mask(1 << b) {}
+    constexpr sim_sbit(int bitaddr) : addr(bitaddr & 0xF8), mask(1 << (bitaddr & 7)) {}
+
+    operator bool() const {
+        bool v;
+        sim_cycle();
+        v = (sim_sfr_read(addr) & mask) != 0;
+        sim_irq_poll();
+        return v;
+    }
+    const sim_sbit &operator=(int v) const {
+        unsigned char old;
+        sim_cycle();
+        old = sim_sfr_latch(addr);
+        sim_sfr_write(addr, v ? (old | mask) : (old & ~mask));
+        sim_irq_poll();
+        return *this;
+    }
+    const sim_sbit &operator=(const sim_sbit &b) const { return *this = (int)(bool)b; }
+};
+
+struct sim_sfr {
+    unsigned char addr;
+    constexpr sim_sfr(int a) : addr(a) {}
+
+    // Keil 的 "sfr^n" 位定义语法
+    constexpr sim_sbit operator^(int b) const { return sim_sbit(addr, b); }
+
+    operator unsigned char() const {
+        unsigned char v;
+        sim_cycle();
+        v = sim_sfr_read(addr);
+        sim_irq_poll();
+        return v;
+    }
+    const sim_sfr &operator=(unsigned int v) const {
+        sim_cycle();
+        sim_sfr_write(addr, (unsigned char)v);
+        sim_irq_poll();
+        return *this;
+    }
+    const sim_sfr &operator=(const sim_sfr &s) const { return *this = (unsigned int)(unsigned char)s; }
+    // 读-改-写指令作用于锁存器而非引脚
+    const sim_sfr &operator|=(unsigned int v) const { return *this = sim_sfr_latch(addr) | v; }
+    const sim_sfr &operator&=(unsigned int v) const { return *this = sim_sfr_latch(addr) & v; }
+    const sim_sfr &operator^=(unsigned int v) const { return *this = sim_sfr_latch(addr) ^ v; }
+};
+
+/* ---------- 仿真控制接口(主机端使用) ---------- */
+typedef void (*sim_isr_t)(void);
+typedef void (*sim_event_t)(void *arg);
+
+extern sim_isr_t sim_vector[SIM_VEC_NUM];   // 中断向量表，由主机端填入固件ISR
+extern bool (*sim_delay_hook)(unsigned int ms); // 返回1表示本次延时已由主机端处理
+extern bool (*sim_idle_hook)(void);             // 返回1表示本次空闲已由主机端处理(快进)
+
+void sim_reset(void);
+void sim_delay_ms(unsigned int ms);         // 替代固件中的空循环延时
+void sim_advance(uint64_t cycles);          // 推进虚拟时间并响应中断
+void sim_at(uint64_t when, sim_event_t fn, void *arg); // 定时回调
+uint64_t sim_next_scheduled(void);          // 下一个定时回调的时间
+void sim_stop_at(uint64_t when);            // 设置仿真结束时间
+void sim_power_fail(void);                  // 电源跌落：置 PCON.LVDF
+
+// 外部引脚驱动(0=拉低, 1=释放)，用于按键等输入
+void sim_pin_drive(unsigned char port, unsigned char bit, bool level);
+
+// 外部流量传感器：继电器吸合期间以 hz 频率向 P3.2 及 T2 输出脉冲(0=使用 P1.0 方波)
+void sim_flow_sensor(double hz);
+
+// UART：注入接收字节，发送字节回调
+void sim_uart_inject(uint64_t when, const char *text);
+extern void (*sim_uart_tx_hook)(unsigned char ch);
+bool sim_uart_busy(void);
+
+// PCA：跳过一段时间，frozen 中的模块(位0/位1)比较器看不到这段时间；
+// 两个模块都冻结时计数器本身停走(快进时使用)
+void sim_pca_skip(uint64_t cycles, unsigned char frozen);
+uint64_t sim_pca_next_match(unsigned char module);
+
+/* ---------- 统计 ---------- */
+struct sim_stats {
+    uint64_t isr_count[SIM_VEC_NUM];
+    uint64_t int0_edges;            // INT0 引脚下降沿
+    uint64_t t2_counts;             // T2 计数器计入的脉冲
+    uint64_t t2_masked;             // P1.0 锁存器为0时被吞掉的传感器下降沿
+    uint64_t t2_false;              // 程序拉低 P1.0 造成的假计数
+    uint64_t relay_on_cycles;       // 继电器吸合累计时间
+    uint64_t relay_switches;
+    uint64_t uart_tx_bytes;
+    uint64_t uart_tx_overruns;      // 发送未完成时写 SBUF
+    uint64_t uart_rx_overruns;      // RI 未清除时到达的新字节
+    uint64_t eeprom_write_cycles;   // 24C02 内部写周期次数
+    uint64_t eeprom_nacks;          // 写周期内被拒绝的寻址
+    uint64_t display_frames;        // 74HC595 锁存次数
+    uint64_t idle_cycles;           // PCON.IDL 中停止取指的时间(含唤醒它的中断)
+};
+extern sim_stats sim_stat;
+
+bool sim_relay_closed(void);
+void sim_finish(void);                          // 结算未结束的统计区间
+
+// 24C02 模型
+#define SIM_EEPROM_SIZE 256
+extern unsigned char sim_eeprom[SIM_EEPROM_SIZE];
+extern uint32_t sim_eeprom_wear[SIM_EEPROM_SIZE]; // 每字节写入次数
+extern uint64_t sim_eeprom_twr;                  // 写周期时长(机器周期)
+
+// 数码管：每一位最近一次锁存的段码(位0为最右侧)
+extern unsigned char sim_display[8];
+void sim_display_text(char *out);               // 转换为可读文本(9字节)
+
+#endif /* __SIM51_H__ */
@@ -1,6 +1,12 @@
 #include "uart.h"
 #include "flowmeter.h"
 #include "keyboard_control.h"
+#include "i2c.h"
+#include "event.h"
+#include "bcd.h"
+#include "power.h"
+#include "sched.h"
+#include "config.h"
 #include <string.h>
 
 // 串口缓冲区及状态变量
@@ -8,6 +14,25 @@ static char xdata uart_buffer[32];  // 缓冲区大小
 static BYTE uart_count = 0;
 static bit uart_complete = 0;
 
+// 发送队列：主程序写tx_head，发送中断读tx_tail
+static BYTE xdata tx_buf[UART_TX_SIZE];
+static BYTE tx_head = 0;
+static BYTE tx_tail = 0;
+static bit tx_busy = 0;             // 发送中断链正在运行
+WORD xdata uart_tx_dropped = 0;     // 中断内回显因队列满丢弃的字节数
+
+// 分行输出：浇水记录和较长的命令回复由主循环逐行写入发送队列
+#define TX_LINE_MAX  56             // 单行最大长度(含回车换行)
+#define TX_NONE      0              // 空闲
+#define TX_RECORD    1              // 浇水记录
+#define TX_HELP      2              // 未知命令时的命令列表
+#define TX_WEAR      3              // WEAR 回复
+#define TX_SCHED     4              // SCHED 回复
+static WateringRecord xdata tx_record;
+static bit tx_record_pending = 0;   // tx_record 等待输出
+static BYTE tx_src = TX_NONE;       // 正在输出的内容
+static BYTE tx_line = 0;            // 下一行序号
+
 // 初始化串口
 void UART_Init(void) {
     SCON = 0x50;    // 设置串口工作方式1，8位UART，可变波特率，REN=1允许接收
@@ -29,6 +54,11 @@ void UART_Init(void) {
     uart_count = 0;
     uart_complete = 0;
     memset(uart_buffer, 0, sizeof(uart_buffer));
+    tx_head = 0;
+    tx_tail = 0;
+    tx_busy = 0;
+    tx_record_pending = 0;
+    tx_src = TX_NONE;
     
     // 发送启动信息（删除DATETIME命令说明）
     UART_SendString("\r\nWatering System Ready v2.1\r\n");
@@ -40,11 +70,37 @@ void UART_Init(void) {
     UART_SendString("STOP\r\n");
 }
 
-// 发送一个字节
+// 非阻塞入队，队列满返回0。接收中断也会回显入队，写队尾和启动发送链时关串口中断
+BYTE UART_PutByte(BYTE dat) {
+    BYTE next;
+    
+    ES = 0;
+    next = (tx_head + 1) & (UART_TX_SIZE - 1);
+    if(next == tx_tail) {
+        ES = 1;
+        return 0;
+    }
+    tx_buf[tx_head] = dat;
+    tx_head = next;
+    if(!tx_busy) {
+        tx_busy = 1;
+        TI = 1;             // 发送链空闲，开中断后由中断取出第一个字节
+    }
+    ES = 1;
+    return 1;
+}
+
+// 队列剩余空间
+BYTE UART_TxFree(void) {
+    return (tx_tail - tx_head - 1) & (UART_TX_SIZE - 1);
+}
+
+// 发送一个字节：队列满时进入空闲模式，等待发送中断腾出空间
 void UART_SendByte(BYTE dat) {
-    SBUF = dat;             // 将数据写入发送缓冲区
-    while(!TI);             // 等待发送完成
-    TI = 0;                 // 清除发送中断标志
+    while(!UART_PutByte(dat)) {
+        POWER_FAIL_CHECK();
+        PCON |= 0x01;       // IDL，任一中断唤醒
+    }
 }
 
 // 发送字符串
@@ -54,19 +110,20 @@ void UART_SendString(char *s) {
     }
 }
 
-// 内联数值输出，避免函数调用开销
+// 数值输出：完整10位，按10的幂相减转换，不调用除法
 static void SendNumber(unsigned long num) {
-    if(num == 0) {
-        UART_SendByte('0');
-        return;
-    }
+    static char xdata num_buf[BCD_FORMAT_SIZE];
     
-    // 直接计算并发送各位数字
-    if(num >= 10000) UART_SendByte('0' + (num / 10000) % 10);
-    if(num >= 1000) UART_SendByte('0' + (num / 1000) % 10);
-    if(num >= 100) UART_SendByte('0' + (num / 100) % 10);
-    if(num >= 10) UART_SendByte('0' + (num / 10) % 10);
-    UART_SendByte('0' + num % 10);
+    BCD_Format(num_buf, num);
+    UART_SendString(num_buf);
+}
+
+// 千分比输出为百分数，一位小数
+static void SendPermille(WORD p) {
+    SendNumber(p / 10);
+    UART_SendByte('.');
+    UART_SendByte('0' + p % 10);
+    UART_SendByte('%');
 }
 
 // 内联两位数输出
@@ -75,118 +132,230 @@ static void Send2Digits(BYTE num) {
     UART_SendByte('0' + (num % 10));
 }
 
-// 避免传参，直接访问全局变量
-void UART_SendManualWateringRecord(void) {
-    UART_SendString("\r\n=== Watering Record ===\r\n");
-    UART_SendString("Type: Manual Watering\r\n");
-    
-    // 开始时间 - 直接访问manual_watering_record
-    UART_SendString("Start Time: 20");
-    Send2Digits(manual_watering_record.start_year % 100);
+// 输出记录中的一个时间点
+static void SendDateTime(WORD year, BYTE month, BYTE day, BYTE hour, BYTE min, BYTE sec) {
+    Send2Digits(year % 100);
     UART_SendByte('-');
-    Send2Digits(manual_watering_record.start_month);
+    Send2Digits(month);
     UART_SendByte('-');
-    Send2Digits(manual_watering_record.start_day);
+    Send2Digits(day);
     UART_SendByte(' ');
-    Send2Digits(manual_watering_record.start_hour);
+    Send2Digits(hour);
     UART_SendByte(':');
-    Send2Digits(manual_watering_record.start_min);
+    Send2Digits(min);
     UART_SendByte(':');
-    Send2Digits(manual_watering_record.start_sec);
+    Send2Digits(sec);
     UART_SendString("\r\n");
-    
-    // 结束时间
-    UART_SendString("End Time: 20");
-    Send2Digits(manual_watering_record.end_year % 100);
-    UART_SendByte('-');
-    Send2Digits(manual_watering_record.end_month);
-    UART_SendByte('-');
-    Send2Digits(manual_watering_record.end_day);
-    UART_SendByte(' ');
-    Send2Digits(manual_watering_record.end_hour);
-    UART_SendByte(':');
-    Send2Digits(manual_watering_record.end_min);
-    UART_SendByte(':');
-    Send2Digits(manual_watering_record.end_sec);
-    UART_SendString("\r\n");
-    
-    // 浇水量
-    UART_SendString("Water Volume: ");
-    SendNumber(manual_watering_record.water_volume);
-    UART_SendString(" ml\r\n");
-    
-    // 累计流量
-    UART_SendString("Total Flow: ");
-    SendNumber(manual_watering_record.total_flow);
-    UART_SendString(" ml\r\n");
-    
-    // 持续时间 - 直接计算，避免传参
-    UART_SendString("Duration: ");
-    if(manual_watering_record.duration_min > 0) {
-        SendNumber(manual_watering_record.duration_min);
-        UART_SendString(" min ");
+}
+
+// 输出tx_record的第line行，返回是否还有下一行
+static bit SendRecordLine(BYTE line) {
+    switch(line) {
+        case 0:
+            UART_SendString("\r\n=== Watering Record ===\r\n");
+            break;
+            
+        case 1:
+            if((tx_record.type & WATERING_TYPE_MASK) == WATERING_TYPE_AUTO) {
+                UART_SendString("Type: Auto Watering");
+            } else {
+                UART_SendString("Type: Manual Watering");
+            }
+            if(tx_record.type & WATERING_TYPE_POWER_FAIL) {
+                UART_SendString(" (Power Fail)");
+            }
+            UART_SendString("\r\n");
+            break;
+            
+        case 2:     // 开始时间
+            UART_SendString("Start Time: 20");
+            SendDateTime(tx_record.start_year, tx_record.start_month, tx_record.start_day,
+                         tx_record.start_hour, tx_record.start_min, tx_record.start_sec);
+            break;
+            
+        case 3:     // 结束时间
+            UART_SendString("End Time: 20");
+            SendDateTime(tx_record.end_year, tx_record.end_month, tx_record.end_day,
+                         tx_record.end_hour, tx_record.end_min, tx_record.end_sec);
+            break;
+            
+        case 4:     // 浇水量，掉电中断的自动浇水另附未浇的水量
+            UART_SendString("Water Volume: ");
+            SendNumber(tx_record.water_volume);
+            UART_SendString(" ml\r\n");
+            if(tx_record.type == (WATERING_TYPE_AUTO | WATERING_TYPE_POWER_FAIL) &&
+               tx_record.water_volume < timed_watering.water_volume_ml) {
+                UART_SendString("Not Delivered: ");
+                SendNumber(timed_watering.water_volume_ml - tx_record.water_volume);
+                UART_SendString(" ml\r\n");
+            }
+            break;
+            
+        case 5:     // 累计流量
+            UART_SendString("Total Flow: ");
+            SendNumber(tx_record.total_flow);
+            UART_SendString(" ml\r\n");
+            break;
+            
+        case 6:     // 持续时间
+            UART_SendString("Duration: ");
+            if(tx_record.duration_min > 0) {
+                SendNumber(tx_record.duration_min);
+                UART_SendString(" min ");
+            }
+            SendNumber(tx_record.duration_sec);
+            UART_SendString(" sec\r\n");
+            break;
+            
+        default:
+            UART_SendString("=======================\r\n");
+            return 0;
     }
-    SendNumber(manual_watering_record.duration_sec);
-    UART_SendString(" sec\r\n");
-    
-    UART_SendString("=======================\r\n");
+    return 1;
 }
 
-// 自动浇水记录输出 - 避免传参，直接访问全局变量
-void UART_SendAutoWateringRecord(void) {
-    UART_SendString("\r\n=== Watering Record ===\r\n");
-    UART_SendString("Type: Auto Watering\r\n");
-    
-    // 开始时间 - 直接访问timed_watering.current_record
-    UART_SendString("Start Time: 20");
-    Send2Digits(timed_watering.current_record.start_year % 100);
-    UART_SendByte('-');
-    Send2Digits(timed_watering.current_record.start_month);
-    UART_SendByte('-');
-    Send2Digits(timed_watering.current_record.start_day);
-    UART_SendByte(' ');
-    Send2Digits(timed_watering.current_record.start_hour);
-    UART_SendByte(':');
-    Send2Digits(timed_watering.current_record.start_min);
-    UART_SendByte(':');
-    Send2Digits(timed_watering.current_record.start_sec);
-    UART_SendString("\r\n");
-    
-    // 结束时间
-    UART_SendString("End Time: 20");
-    Send2Digits(timed_watering.current_record.end_year % 100);
-    UART_SendByte('-');
-    Send2Digits(timed_watering.current_record.end_month);
-    UART_SendByte('-');
-    Send2Digits(timed_watering.current_record.end_day);
-    UART_SendByte(' ');
-    Send2Digits(timed_watering.current_record.end_hour);
-    UART_SendByte(':');
-    Send2Digits(timed_watering.current_record.end_min);
-    UART_SendByte(':');
-    Send2Digits(timed_watering.current_record.end_sec);
+// 命令列表
+static bit SendHelpLine(BYTE line) {
+    switch(line) {
+        case 0:  UART_SendString("\r\nError: Unknown cmd\r\n"); break;
+        case 1:  UART_SendString("Commands:\r\n"); break;
+        case 2:  UART_SendString("TIME:HH:MM:SS - Set time\r\n"); break;
+        case 3:  UART_SendString("DATE:YYYY:MM:DD - Set date\r\n"); break;
+        case 4:  UART_SendString("A:HH:MM:SS:MMMM - Set auto watering\r\n"); break;
+        case 5:  UART_SendString("DISPTIME/DISPDATE - Display mode\r\n"); break;
+        case 6:  UART_SendString("STOP - Stop auto watering\r\n"); break;
+        case 7:  UART_SendString("M:MMMM - Manual watering cap\r\n"); break;
+        case 8:  UART_SendString("WEAR - EEPROM write count\r\n"); break;
+        case 9:  UART_SendString("DUTY - CPU awake ratio\r\n"); break;
+        case 10: UART_SendString("SCHED - Task deadline misses\r\n"); break;
+        default: UART_SendString("SLEEP:HH:HH/OFF - Display sleep hours\r\n"); return 0;
+    }
+    return 1;
+}
+
+// 累计流量日志写入统计
+static bit SendWearLine(BYTE line) {
+    switch(line) {
+        case 0:
+            UART_SendString("\r\nFlow Log Writes: ");
+            SendNumber(AT24C02_GetFlowWrites());
+            break;
+            
+        case 1:
+            UART_SendString("Slot: ");
+            SendNumber(AT24C02_GetFlowSlot());
+            UART_SendByte('/');
+            SendNumber(FLOW_LOG_SLOTS);
+            break;
+            
+        case 2:
+            UART_SendString("Bus Errors: ");
+            SendNumber(I2C_GetErrors());
+            break;
+            
+        case 3:
+            UART_SendString("Write Cycle: ");
+            SendNumber(EEPROM_GetCycleLast());
+            UART_SendString("us, max ");
+            SendNumber(EEPROM_GetCycleMax());
+            UART_SendString("us, timeouts ");
+            SendNumber(EEPROM_GetTimeouts());
+            break;
+            
+        default:
+            UART_SendString("Power Fails: ");
+            SendNumber(Power_GetFails());
+            UART_SendString("\r\n");
+            return 0;
+    }
     UART_SendString("\r\n");
-    
-    // 浇水量
-    UART_SendString("Water Volume: ");
-    SendNumber(timed_watering.current_record.water_volume);
-    UART_SendString(" ml\r\n");
-    
-    // 累计流量
-    UART_SendString("Total Flow: ");
-    SendNumber(timed_watering.current_record.total_flow);
-    UART_SendString(" ml\r\n");
-    
-    // 持续时间
-    UART_SendString("Duration: ");
-    if(timed_watering.current_record.duration_min > 0) {
-        SendNumber(timed_watering.current_record.duration_min);
-        UART_SendString(" min ");
+    return 1;
+}
+
+// 调度统计：逐个任务输出超时次数和最大延迟(10ms节拍)，再输出丢失的事件和回显字节
+static bit SendSchedLine(BYTE line) {
+    if(line == 0) {
+        UART_SendString("\r\n");
+    } else if(line <= SCHED_TASKS) {
+        UART_SendString("Task ");
+        SendNumber(line - 1);
+        UART_SendString(": miss ");
+        SendNumber(Sched_GetMisses(line - 1));
+        UART_SendString(", max ");
+        SendNumber(Sched_GetWorst(line - 1));
+        UART_SendString("\r\n");
+    } else if(line == SCHED_TASKS + 1) {
+        UART_SendString("Lost events: ");
+        SendNumber(evt_overflow);
+        UART_SendString("\r\n");
+    } else {
+        UART_SendString("Echo dropped: ");
+        SendNumber(uart_tx_dropped);
+        UART_SendString("\r\n");
+        return 0;
     }
-    SendNumber(timed_watering.current_record.duration_sec);
-    UART_SendString(" sec\r\n");
+    return 1;
+}
+
+// 输出当前内容的下一行，没有正在输出的内容时开始输出待发送的记录
+static void SendNextLine(void) {
+    bit more;
     
-    UART_SendString("=======================\r\n");
+    if(tx_src == TX_NONE) {
+        if(!tx_record_pending) {
+            return;
+        }
+        tx_record_pending = 0;
+        tx_src = TX_RECORD;
+        tx_line = 0;
+    }
+    switch(tx_src) {
+        case TX_RECORD: more = SendRecordLine(tx_line); break;
+        case TX_HELP:   more = SendHelpLine(tx_line);   break;
+        case TX_WEAR:   more = SendWearLine(tx_line);   break;
+        default:        more = SendSchedLine(tx_line);  break;
+    }
+    tx_line++;
+    if(!more) {
+        tx_src = TX_NONE;
+    }
+}
+
+// 开始分行输出一段回复
+static void StartReply(BYTE src) {
+    tx_src = src;
+    tx_line = 0;
+}
+
+// 保存记录副本，由主循环逐行输出
+static void QueueRecord(WateringRecord *rec) {
+    // 上一条记录尚未输出完，先阻塞补完(极少发生)
+    while(tx_record_pending || tx_src == TX_RECORD) {
+        SendNextLine();
+    }
+    memcpy(&tx_record, rec, sizeof(WateringRecord));
+    tx_record_pending = 1;
+}
+
+// 队列能容纳整行时才输出一行，主循环不会因记录和长回复而等待；
+// 输出空闲后处理被推迟的命令
+void UART_Poll(void) {
+    if(UART_TxFree() >= TX_LINE_MAX) {
+        SendNextLine();
+    }
+    if(uart_complete) {
+        UART_ProcessCommand();
+    }
+}
+
+// 发送手动浇水记录
+void UART_SendManualWateringRecord(void) {
+    QueueRecord(&manual_watering_record);
+}
+
+// 发送自动浇水记录
+void UART_SendAutoWateringRecord(void) {
+    QueueRecord(&timed_watering.current_record);
 }
 
 // 数字转换辅助函数
@@ -273,11 +442,15 @@ static void UART_CommandHandler(void) {
     }
     // 显示模式切换命令: "DISPTIME" 或 "DISPDATE"
     else if(strncmp(uart_buffer, "DISPTIME", 8) == 0) {
+        datetime_display_pref = DISPLAY_TIME_MODE;
         PCA_SetDisplayMode(DISPLAY_TIME_MODE);
+        Config_Save();
         UART_SendString("\r\nDisplay Mode: Time\r\n");
     }
     else if(strncmp(uart_buffer, "DISPDATE", 8) == 0) {
+        datetime_display_pref = DISPLAY_DATE_MODE;
         PCA_SetDisplayMode(DISPLAY_DATE_MODE);
+        Config_Save();
         UART_SendString("\r\nDisplay Mode: Date\r\n");
     }
     // 定时浇水设置命令格式: "A:HH:MM:SS:MMMM"
@@ -307,6 +480,7 @@ static void UART_CommandHandler(void) {
                 timed_watering.water_volume_ml = volume;
                 timed_watering.enabled = 1;
                 timed_watering.triggered_today = 0;
+                Config_Save();
                 
                 UART_SendString("\r\nAuto Set OK\r\n");
                 UART_SendString("Time: ");
@@ -331,25 +505,89 @@ static void UART_CommandHandler(void) {
             UART_SendString("Example: A:06:00:01:0100\r\n");
         }
     }
+    // 手动浇水水量上限命令: "M:MMMM"，0000表示不限
+    else if(strncmp(uart_buffer, "M:", 2) == 0) {
+        WORD cap = 0xFFFF;
+        
+        if(strlen(uart_buffer) >= 6) {
+            cap = ParseNumber(uart_buffer + 2, 4);
+        }
+        if(cap != 0xFFFF) {
+            manual_volume_cap = cap;
+            Config_Save();
+            if(cap == 0) {
+                UART_SendString("\r\nManual Cap: Off\r\n");
+            } else {
+                UART_SendString("\r\nManual Cap: ");
+                SendNumber(cap);
+                UART_SendString("ml\r\n");
+            }
+        }
+        else {
+            UART_SendString("\r\nError: Wrong format\r\n");
+            UART_SendString("Format: M:MMMM (0000=no cap)\r\n");
+        }
+    }
+    // 累计流量日志写入统计: "WEAR"
+    else if(strncmp(uart_buffer, "WEAR", 4) == 0) {
+        StartReply(TX_WEAR);
+    }
+    // 占空比: "DUTY"，输出上一秒和上电以来主循环醒着的比例及关屏睡眠时间
+    else if(strncmp(uart_buffer, "DUTY", 4) == 0) {
+        UART_SendString("\r\nAwake: ");
+        SendPermille(Power_GetAwakeLast());
+        UART_SendString(" (1s), ");
+        SendPermille(Power_GetAwakeAvg());
+        UART_SendString(" (avg)\r\nSleep: ");
+        SendNumber(Power_GetSleepSeconds());
+        UART_SendString("s\r\n");
+    }
+    // 调度统计: "SCHED"
+    else if(strncmp(uart_buffer, "SCHED", 5) == 0) {
+        StartReply(TX_SCHED);
+    }
+    // 睡眠时段: "SLEEP:HH:HH"(开始:结束小时，相等为全天) 或 "SLEEP:OFF"
+    else if(strncmp(uart_buffer, "SLEEP:", 6) == 0) {
+        WORD start = 0xFFFF, end = 0xFFFF;
+        
+        if(strncmp(uart_buffer + 6, "OFF", 3) == 0) {
+            power_sleep_start = POWER_SLEEP_OFF;
+            Config_Save();
+            UART_SendString("\r\nSleep: Off\r\n");
+        } else {
+            if(strlen(uart_buffer) >= 11 && uart_buffer[8] == ':') {
+                start = ParseNumber(uart_buffer + 6, 2);
+                end = ParseNumber(uart_buffer + 9, 2);
+            }
+            if(start < 24 && end < 24) {
+                power_sleep_start = start;
+                power_sleep_end = end;
+                Config_Save();
+                UART_SendString("\r\nSleep: ");
+                SendNumber(start);
+                UART_SendString("h-");
+                SendNumber(end);
+                UART_SendString("h\r\n");
+            } else {
+                UART_SendString("\r\nError: Wrong format\r\n");
+                UART_SendString("Format: SLEEP:HH:HH or SLEEP:OFF\r\n");
+            }
+        }
+    }
     // 停止定时浇水命令: "STOP"
     else if(strncmp(uart_buffer, "STOP", 4) == 0) {
         TimedWatering_Stop();
         UART_SendString("\r\nAuto Stopped\r\n");
     }
     else {
-        UART_SendString("\r\nError: Unknown cmd\r\n");
-        UART_SendString("Commands:\r\n");
-        UART_SendString("TIME:HH:MM:SS - Set time\r\n");
-        UART_SendString("DATE:YYYY:MM:DD - Set date\r\n");
-        UART_SendString("A:HH:MM:SS:MMMM - Set auto watering\r\n");
-        UART_SendString("DISPTIME/DISPDATE - Display mode\r\n");
-        UART_SendString("STOP - Stop auto watering\r\n");
+        StartReply(TX_HELP);
     }
 }
 
-// 处理串口命令
+// 处理串口命令(收到 EVT_UART_LINE 时调用)。上一段输出未完时推迟到 UART_Poll，
+// 等发送队列空出后再执行。其余回复最长约80字节，超出队列的部分最多等十几毫秒
 void UART_ProcessCommand(void) {
-    if(uart_complete) {
+    if(uart_complete && tx_src == TX_NONE && UART_TxFree() == UART_TX_SIZE - 1) {
         UART_CommandHandler();
         uart_complete = 0;
         uart_count = 0;
@@ -365,13 +603,22 @@ void UART_ISR() interrupt 4 {
         if(!uart_complete) { // 如果前一条命令还没处理完，则忽略当前接收的字符
             char ch = SBUF;  // 获取接收到的字符
             
-            // 回显接收到的字符
-            UART_SendByte(ch);
+            // 回显接收到的字符：不能在中断内等待，队列满则丢弃
+            if(!tx_busy) {
+                tx_busy = 1;
+                SBUF = ch;
+            } else if(((tx_head + 1) & (UART_TX_SIZE - 1)) != tx_tail) {
+                tx_buf[tx_head] = ch;
+                tx_head = (tx_head + 1) & (UART_TX_SIZE - 1);
+            } else {
+                uart_tx_dropped++;
+            }
             
             if(ch == '\n' || ch == '\r') { // 接收到回车或换行
                 uart_buffer[uart_count] = '\0';  // 字符串结束符
                 if (uart_count > 0) {  // 非空命令才进行处理
-                    uart_complete = 1;  // 设置接收完成标志
+                    uart_complete = 1;  // 锁定缓冲区直到命令处理完
+                    EVENT_POST(EVT_UART_LINE);
                 }
             }
             else if(uart_count < UART_BUF_SIZE - 1) { // 缓冲区未满
@@ -382,5 +629,12 @@ void UART_ISR() interrupt 4 {
     
     if(TI) {                // 发送中断
         TI = 0;             // 清除发送中断标志
+        
+        if(tx_tail != tx_head) {
+            SBUF = tx_buf[tx_tail];
+            tx_tail = (tx_tail + 1) & (UART_TX_SIZE - 1);
+        } else {
+            tx_busy = 0;    // 队列已空，发送链停止
+        }
     }
 }
@@ -7,10 +7,12 @@
 // 浇水类型定义
 #define WATERING_TYPE_MANUAL 0    // 手动浇水
 #define WATERING_TYPE_AUTO   1    // 自动浇水
+#define WATERING_TYPE_MASK   0x0F
+#define WATERING_TYPE_POWER_FAIL 0x80 // 标志：浇水中掉电，上电后补出的记录
 
 // 浇水记录结构体
 typedef struct {
-    BYTE type;                    // 浇水类型 (0=手动, 1=自动)
+    BYTE type;                    // 浇水类型 (0=手动, 1=自动)，可带 WATERING_TYPE_POWER_FAIL
     WORD start_year;              // 开始年份
     BYTE start_month;             // 开始月份
     BYTE start_day;               // 开始日期
@@ -32,13 +34,25 @@ typedef struct {
 // 串口命令处理相关定义
 #define UART_BUF_SIZE 32    // 缓冲区大小
 
+// 发送队列：由发送中断逐字节取出，主程序入队不等待
+// 溢出策略：UART_PutByte 队列满返回0；UART_SendByte 队列满时空闲等待；
+// 中断内回显队列满时丢弃并计入 uart_tx_dropped(SCHED 命令输出)
+// 超过一个队列的输出(浇水记录、命令列表、WEAR、SCHED)由 UART_Poll 逐行写入，
+// 命令在发送队列空出后才执行，其余回复(最长约80字节)直接入队
+#define UART_TX_SIZE 64     // 发送队列大小(必须为2的幂)
+
+extern WORD xdata uart_tx_dropped;       // 回显丢弃字节数
+
 // 函数声明
 void UART_Init(void);                    // 初始化串口
-void UART_SendByte(BYTE dat);            // 发送一个字节
+void UART_SendByte(BYTE dat);            // 发送一个字节(队列满时等待)
+BYTE UART_PutByte(BYTE dat);             // 非阻塞入队，队列满返回0
+BYTE UART_TxFree(void);                  // 发送队列剩余空间
 void UART_SendString(char *s);           // 发送字符串
-void UART_ProcessCommand(void);          // 处理串口命令
+void UART_ProcessCommand(void);          // 处理串口命令(EVT_UART_LINE)
+void UART_Poll(void);                    // 逐行输出记录和长回复，执行推迟的命令(主循环中调用)
 
-// 浇水记录输出函数 - 避免传参
+// 浇水记录输出函数 - 保存副本后由 UART_Poll 逐行输出
 void UART_SendManualWateringRecord(void); // 发送手动浇水记录
 void UART_SendAutoWateringRecord(void);   // 发送自动浇水记录
 